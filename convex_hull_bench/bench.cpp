@@ -0,0 +1,262 @@
+// Benchmarks of make_convex_hull() on generated point sets.
+// The results are printed as JSON; --benchmark_format=console overrides it.
+// The counters are the input points per second, the vertices of the hull
+// and how much the resident memory grew over the one with the input ready.
+// BM_Classify measures the points per second HullClassifier tests against
+// the hull of points on the sphere, all vertices of it.
+
+#include "hull_classifier.hh"
+#include "point_hull.hh"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#else
+#include <fstream>
+#endif
+
+namespace {
+
+enum class Distribution {
+  // Uniform in the cube [-1, 1]^3.
+  Cube,
+  // Uniform on the unit sphere: every point is on the hull.
+  Sphere,
+  // Standard normal in every coordinate.
+  Gaussian,
+  // Normal around 64 centres uniform in the cube.
+  Clustered,
+  // Axis aligned integer lattice.
+  Grid,
+  // Uniform on 4 planes z == const.
+  Slabs
+};
+
+Points generate(Distribution _dist, size_t _size) {
+  Points pts(_size);
+  std::mt19937_64 gen(0);
+  std::uniform_real_distribution<double> unif(-1, 1);
+  std::normal_distribution<double> norm;
+  switch (_dist) {
+  case Distribution::Cube:
+    for (auto &pt : pts)
+      pt = {unif(gen), unif(gen), unif(gen)};
+    break;
+  case Distribution::Sphere:
+    for (auto &pt : pts) {
+      do
+        pt = {norm(gen), norm(gen), norm(gen)};
+      while (Geo::length_square(pt) == 0);
+      pt /= Geo::length(pt);
+    }
+    break;
+  case Distribution::Gaussian:
+    for (auto &pt : pts)
+      pt = {norm(gen), norm(gen), norm(gen)};
+    break;
+  case Distribution::Clustered: {
+    std::vector<Geo::VectorD3> centers(64);
+    for (auto &cen : centers)
+      cen = {unif(gen), unif(gen), unif(gen)};
+    std::uniform_int_distribution<size_t> pick(0, centers.size() - 1);
+    std::normal_distribution<double> spread(0, 0.02);
+    for (auto &pt : pts)
+      pt = centers[pick(gen)] +
+           Geo::VectorD3{spread(gen), spread(gen), spread(gen)};
+    break;
+  }
+  case Distribution::Grid: {
+    auto side = size_t(std::ceil(std::cbrt(double(_size))));
+    for (size_t i = 0; i < _size; ++i)
+      pts[i] = {double(i % side), double(i / side % side),
+                double(i / (side * side))};
+    break;
+  }
+  case Distribution::Slabs:
+    for (size_t i = 0; i < _size; ++i)
+      pts[i] = {unif(gen), unif(gen), double(i % 4)};
+    break;
+  }
+  return pts;
+}
+
+// The benchmarks of a distribution run one after the other: keeps only the
+// last generated set.
+const Points &cached_points(Distribution _dist, size_t _size) {
+  static Distribution last_dist;
+  static Points last_pts;
+  if (last_pts.size() != _size || last_dist != _dist) {
+    last_pts = Points();
+    last_pts = generate(_dist, _size);
+    last_dist = _dist;
+  }
+  return last_pts;
+}
+
+// Resident memory of the process in MiB: the current one and the peak since
+// the start or the last reset_peak_rss().
+struct Rss {
+  double m_current = 0;
+  double m_peak = 0;
+};
+
+Rss read_rss() {
+  Rss rss;
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+    rss.m_current = pmc.WorkingSetSize / (1024. * 1024.);
+    rss.m_peak = pmc.PeakWorkingSetSize / (1024. * 1024.);
+  }
+#elif defined(__APPLE__)
+  mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS)
+    rss.m_current = info.resident_size / (1024. * 1024.);
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    rss.m_peak = usage.ru_maxrss / (1024. * 1024.);
+#else
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  double kb;
+  while (status >> key) {
+    if (key == "VmRSS:" && status >> kb)
+      rss.m_current = kb / 1024.;
+    else if (key == "VmHWM:" && status >> kb)
+      rss.m_peak = kb / 1024.;
+  }
+#endif
+  return rss;
+}
+
+// Restarts the peak from the current resident memory. Only Linux can: the
+// other systems keep the peak of the whole process and return false.
+bool reset_peak_rss() {
+#if defined(_WIN32) || defined(__APPLE__)
+  return false;
+#else
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+  clear_refs.close();
+  return bool(clear_refs);
+#endif
+}
+
+// Engines of the second benchmark argument.
+enum EngineArg { DC_SERIAL, DC_PARALLEL, QUICK_HULL, DC_PRESORT };
+
+void BM_ConvexHull(benchmark::State &_state, Distribution _dist) {
+  auto size = size_t(_state.range(0));
+  HullOptions opts;
+  switch (_state.range(1)) {
+  case DC_PARALLEL:
+    opts.m_executor = IExecutor::make_thread_pool();
+    break;
+  case QUICK_HULL:
+    opts.m_engine = HullEngine::QuickHull;
+    break;
+  case DC_PRESORT:
+    opts.m_presort = true;
+    break;
+  }
+  const auto &input = cached_points(_dist, size);
+  // make_convex_hull() reorders the points, so every iteration takes a copy
+  // of the input. The copy is made resident before the rss is read and then
+  // refilled in place: the count is only the memory of make_convex_hull().
+  // The input is out of it too, the benchmarks of a distribution share it.
+  auto pts = input;
+  auto peak_reset = reset_peak_rss();
+  auto before = read_rss();
+  size_t hull_size = 0;
+  for (auto _ : _state) {
+    _state.PauseTiming();
+    std::copy(input.begin(), input.end(), pts.begin());
+    _state.ResumeTiming();
+    try {
+      auto mesh = make_convex_hull(pts, opts);
+      hull_size = mesh->size();
+    } catch (const char *_err) {
+      _state.SkipWithError(_err);
+      break;
+    }
+  }
+  _state.SetItemsProcessed(_state.iterations() * size);
+  _state.counters["hull_vertices"] = double(hull_size);
+  // -1 if the peak of an earlier benchmark hides the one of this: run it
+  // alone with --benchmark_filter.
+  auto after = read_rss();
+  _state.counters["rss_increase_mb"] =
+      peak_reset || after.m_peak > before.m_peak
+          ? after.m_peak - before.m_current
+          : -1.;
+}
+
+void hull_args(benchmark::internal::Benchmark *_bench) {
+  _bench->ArgNames({"points", "engine"})
+      ->ArgsProduct({benchmark::CreateRange(1000, 100000000, 10),
+                     {DC_SERIAL, DC_PARALLEL, QUICK_HULL, DC_PRESORT}})
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+}
+
+BENCHMARK_CAPTURE(BM_ConvexHull, cube, Distribution::Cube)->Apply(hull_args);
+BENCHMARK_CAPTURE(BM_ConvexHull, sphere, Distribution::Sphere)
+    ->Apply(hull_args);
+BENCHMARK_CAPTURE(BM_ConvexHull, gaussian, Distribution::Gaussian)
+    ->Apply(hull_args);
+BENCHMARK_CAPTURE(BM_ConvexHull, clustered, Distribution::Clustered)
+    ->Apply(hull_args);
+BENCHMARK_CAPTURE(BM_ConvexHull, grid, Distribution::Grid)->Apply(hull_args);
+BENCHMARK_CAPTURE(BM_ConvexHull, slabs, Distribution::Slabs)
+    ->Apply(hull_args);
+
+void BM_Classify(benchmark::State &_state) {
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  auto sphere = generate(Distribution::Sphere, size_t(_state.range(0)));
+  HullClassifier classifier(*make_convex_hull(sphere, opts));
+  auto queries = generate(Distribution::Cube, size_t(_state.range(1)));
+  std::vector<uint8_t> inside(queries.size());
+  auto exec = _state.range(2) != 0 ? IExecutor::make_thread_pool() : nullptr;
+  size_t inside_nmbr = 0;
+  for (auto _ : _state)
+    inside_nmbr = classifier.classify(queries.data(), queries.size(),
+                                      inside.data(), exec.get());
+  _state.SetItemsProcessed(_state.iterations() * queries.size());
+  _state.counters["planes"] = double(classifier.planes());
+  _state.counters["inside"] = double(inside_nmbr);
+}
+
+BENCHMARK(BM_Classify)
+    ->ArgNames({"hull_vertices", "points", "parallel"})
+    ->ArgsProduct({benchmark::CreateRange(8, 1 << 20, 16), {1 << 22}, {0, 1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  // JSON unless the command line asks for another format.
+  std::vector<char *> args(argv, argv + argc);
+  std::string json_format = "--benchmark_format=json";
+  args.insert(args.begin() + 1, &json_format[0]);
+  int arg_nmbr = int(args.size());
+  benchmark::Initialize(&arg_nmbr, args.data());
+  if (benchmark::ReportUnrecognizedArguments(arg_nmbr, args.data()))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,265 @@
+#include "approx_hull.hh"
+#include "quick_hull.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <numeric>
+
+namespace {
+
+// Extreme points of _points along the directions [_first, end) of _dirs.
+void add_supports(const Points &_points, const std::vector<Geo::VectorD3> &_dirs,
+                  size_t _first, std::vector<double> &_dist,
+                  std::vector<Geo::VectorD3> &_support, IExecutor *_exec) {
+  auto dir_nmbr = _dirs.size() - _first;
+  _dist.resize(_dirs.size(), std::numeric_limits<double>::lowest());
+  _support.resize(_dirs.size());
+  // The directions in structure of arrays layout and a loop without
+  // branches, that the compiler can vectorize.
+  std::vector<double> dir_x(dir_nmbr), dir_y(dir_nmbr), dir_z(dir_nmbr);
+  for (size_t k = 0; k < dir_nmbr; ++k) {
+    dir_x[k] = _dirs[_first + k][0];
+    dir_y[k] = _dirs[_first + k][1];
+    dir_z[k] = _dirs[_first + k][2];
+  }
+  std::mutex mtx;
+  parallel_for(_exec, _points.size(), 1 << 16, [&](size_t _b, size_t _e) {
+    std::vector<double> dist(dir_nmbr, std::numeric_limits<double>::lowest());
+    std::vector<uint64_t> idx(dir_nmbr, 0);
+    for (auto i = _b; i < _e; ++i) {
+      auto x = _points[i][0], y = _points[i][1], z = _points[i][2];
+      for (size_t k = 0; k < dir_nmbr; ++k) {
+        auto val = dir_x[k] * x + dir_y[k] * y + dir_z[k] * z;
+        auto more = val > dist[k];
+        dist[k] = more ? val : dist[k];
+        idx[k] = more ? i : idx[k];
+      }
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    for (size_t k = 0; k < dir_nmbr; ++k) {
+      if (dist[k] > _dist[_first + k]) {
+        _dist[_first + k] = dist[k];
+        _support[_first + k] = _points[idx[k]];
+      }
+    }
+  });
+}
+
+// Point of the triangle _a, _b, _c closest to _pt.
+Geo::VectorD3 closest_on_triangle(const Geo::VectorD3 &_pt,
+                                  const Geo::VectorD3 &_a,
+                                  const Geo::VectorD3 &_b,
+                                  const Geo::VectorD3 &_c) {
+  auto ab = _b - _a, ac = _c - _a, ap = _pt - _a;
+  auto d1 = ab * ap, d2 = ac * ap;
+  if (d1 <= 0 && d2 <= 0)
+    return _a;
+  auto bp = _pt - _b;
+  auto d3 = ab * bp, d4 = ac * bp;
+  if (d3 >= 0 && d4 <= d3)
+    return _b;
+  auto vc = d1 * d4 - d3 * d2;
+  if (vc <= 0 && d1 >= 0 && d3 <= 0)
+    return _a + (d1 / (d1 - d3)) * ab;
+  auto cp = _pt - _c;
+  auto d5 = ab * cp, d6 = ac * cp;
+  if (d6 >= 0 && d5 <= d6)
+    return _c;
+  auto vb = d5 * d2 - d1 * d6;
+  if (vb <= 0 && d2 >= 0 && d6 <= 0)
+    return _a + (d2 / (d2 - d6)) * ac;
+  auto va = d3 * d6 - d5 * d4;
+  if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+    return _b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (_c - _b);
+  auto den = va + vb + vc;
+  if (den == 0)
+    return _a;
+  return _a + (vb / den) * ab + (vc / den) * ac;
+}
+
+// Intersection of the planes _dirs[i] * x == _dist[i] of _idx.
+Geo::VectorD3 intersect_planes(const std::vector<Geo::VectorD3> &_dirs,
+                               const std::vector<double> &_dist,
+                               const std::array<VertIdx, 3> &_idx) {
+  const auto &n0 = _dirs[_idx[0]], &n1 = _dirs[_idx[1]], &n2 = _dirs[_idx[2]];
+  auto n12 = n1 % n2, n20 = n2 % n0, n01 = n0 % n1;
+  auto det = n0 * n12;
+  return (_dist[_idx[0]] * n12 + _dist[_idx[1]] * n20 +
+          _dist[_idx[2]] * n01) /
+         det;
+}
+
+} // namespace
+
+std::unique_ptr<Mesh> make_approx_hull(const Points &_points,
+                                       size_t _max_vertices,
+                                       double _max_error, IExecutor *_exec) {
+  if (_max_vertices < 4)
+    throw "Error";
+  auto mesh = std::make_unique<Mesh>();
+  if (_points.empty())
+    return mesh;
+  // A polytope of n planes has at most 2 n - 4 vertices.
+  auto max_dirs = _max_vertices / 2 + 2;
+  std::vector<Geo::VectorD3> dirs;
+  if (max_dirs >= 14) {
+    for (double x : {-1., 1.}) {
+      dirs.push_back({x, 0, 0});
+      dirs.push_back({0, x, 0});
+      dirs.push_back({0, 0, x});
+      for (double y : {-1., 1.}) {
+        for (double z : {-1., 1.})
+          dirs.push_back(Geo::VectorD3{x, y, z} / std::sqrt(3.));
+      }
+    }
+  } else if (max_dirs >= 6) {
+    for (double x : {-1., 1.}) {
+      dirs.push_back({x, 0, 0});
+      dirs.push_back({0, x, 0});
+      dirs.push_back({0, 0, x});
+    }
+  } else {
+    for (auto &dir : {Geo::VectorD3{1, 1, 1}, Geo::VectorD3{1, -1, -1},
+                      Geo::VectorD3{-1, 1, -1}, Geo::VectorD3{-1, -1, 1}})
+      dirs.push_back(dir / std::sqrt(3.));
+  }
+  std::vector<double> dist;
+  std::vector<Geo::VectorD3> support;
+  add_supports(_points, dirs, 0, dist, support, _exec);
+
+  // The margin keeps the planes off the points, so the polytope has a
+  // strict interior even for flat sets, and the rounding of its vertices
+  // outwards.
+  Geo::VectorD3 center{};
+  for (const auto &pt : support)
+    center += pt;
+  center /= double(support.size());
+  double size = 0;
+  for (const auto &pt : support) {
+    for (size_t c = 0; c < 3; ++c)
+      size = std::max({size, std::fabs(pt[c] - center[c]),
+                       std::fabs(center[c])});
+  }
+  auto margin = 1e-6 * (size > 0 ? size : 1.);
+
+  QuickHull dual, inner;
+  std::vector<Geo::VectorD3> dual_pts, verts, gaps;
+  std::vector<double> plane_dist;
+  std::vector<VertIdx> poles, plane_of;
+  for (;;) {
+    // Polytope of the planes: its vertices are the faces of the hull of the
+    // poles of the planes around the center.
+    plane_dist.resize(dirs.size());
+    dual_pts.resize(dirs.size());
+    for (size_t i = 0; i < dirs.size(); ++i) {
+      plane_dist[i] = dist[i] + margin;
+      dual_pts[i] = dirs[i] / (plane_dist[i] - dirs[i] * center);
+    }
+    if (!dual.build(dual_pts.data(), dual_pts.size()))
+      throw "Error";
+    // The plane of every vertex of the dual hull.
+    poles.resize(dirs.size());
+    std::iota(poles.begin(), poles.end(), 0);
+    std::sort(poles.begin(), poles.end(), [&dual_pts](VertIdx _a, VertIdx _b) {
+      return dual_pts[_a] < dual_pts[_b];
+    });
+    plane_of.resize(dual.vertices().size());
+    for (size_t v = 0; v < plane_of.size(); ++v) {
+      plane_of[v] = *std::lower_bound(
+          poles.begin(), poles.end(), dual.vertices()[v],
+          [&dual_pts](VertIdx _a, const Geo::VectorD3 &_pt) {
+            return dual_pts[_a] < _pt;
+          });
+    }
+    verts.clear();
+    for (size_t f = 0; f < dual.faces().size(); ++f) {
+      const auto &face = dual.faces()[f];
+      if (!face.m_alive)
+        continue;
+      std::array<VertIdx, 3> planes;
+      for (size_t k = 0; k < 3; ++k)
+        planes[k] = plane_of[face.m_vert[k]];
+      auto pt = intersect_planes(dirs, plane_dist, planes);
+      // Faces of coplanar poles give the same vertex. The vertices closer
+      // than half the margin are merged too: moving the vertices of a
+      // polytope by r moves its faces by r at most, so it still contains
+      // the points.
+      auto same = std::find_if(verts.begin(), verts.end(),
+                               [&pt, margin](const Geo::VectorD3 &_oth) {
+                                 return Geo::length(_oth - pt) < margin / 2;
+                               });
+      if (same == verts.end())
+        verts.push_back(pt);
+    }
+    if (dirs.size() == max_dirs && _max_error == 0)
+      break;
+
+    // Distance of every vertex from the hull of the extreme points, that
+    // is inside the hull of all the points.
+    gaps.resize(verts.size());
+    double max_gap = 0;
+    bool solid = inner.build(support.data(), support.size());
+    for (size_t v = 0; v < verts.size(); ++v) {
+      Geo::VectorD3 closest = support[0];
+      if (solid) {
+        auto best = std::numeric_limits<double>::max();
+        for (const auto &face : inner.faces()) {
+          if (!face.m_alive)
+            continue;
+          const auto &iv = inner.vertices();
+          auto pt = closest_on_triangle(verts[v], iv[face.m_vert[0]],
+                                        iv[face.m_vert[1]],
+                                        iv[face.m_vert[2]]);
+          auto len = Geo::length_square(verts[v] - pt);
+          if (len < best) {
+            best = len;
+            closest = pt;
+          }
+        }
+      } else {
+        for (const auto &pt : support) {
+          if (Geo::length_square(verts[v] - pt) <
+              Geo::length_square(verts[v] - closest))
+            closest = pt;
+        }
+      }
+      gaps[v] = verts[v] - closest;
+      max_gap = std::max(max_gap, Geo::length(gaps[v]));
+    }
+    if (dirs.size() == max_dirs || max_gap <= _max_error)
+      break;
+
+    // New directions along the largest gaps, at most as many as the old
+    // ones.
+    std::vector<size_t> order(verts.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&gaps](size_t _a, size_t _b) {
+      return Geo::length_square(gaps[_a]) > Geo::length_square(gaps[_b]);
+    });
+    auto first = dirs.size();
+    auto add_nmbr = std::min(first, max_dirs - first);
+    for (auto v : order) {
+      if (dirs.size() - first == add_nmbr)
+        break;
+      auto len = Geo::length(gaps[v]);
+      if (len <= margin)
+        break;
+      auto dir = gaps[v] / len;
+      bool repeated = false;
+      for (const auto &oth : dirs)
+        repeated |= dir * oth > 1 - 1e-12;
+      if (!repeated)
+        dirs.push_back(dir);
+    }
+    if (dirs.size() == first)
+      break;
+    add_supports(_points, dirs, first, dist, support, _exec);
+  }
+
+  // The hull of the vertices rather than the faces of the dual: the planes
+  // of nearly parallel directions meet at vertices with large rounding.
+  make_quick_hull(verts.data(), verts.size(), nullptr, *mesh);
+  return mesh;
+}
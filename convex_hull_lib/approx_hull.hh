@@ -0,0 +1,18 @@
+#pragma once
+
+#include "point_hull.hh"
+
+// Conservative approximation of the hull of _points with at most
+// _max_vertices vertices (4 or more): the intersection of the half spaces
+// beyond the extreme points along a set of directions. It contains every
+// point, with a margin of 1e-6 times the size of the set that keeps the
+// rounding outwards. The directions start from the axes and the diagonals
+// of the box and are added in passes, each one at the vertices farthest
+// from the hull of the extreme points found so far. The passes stop when
+// no vertex is farther than _max_error from it, or when the budget is used;
+// with _max_error == 0 the budget is always used. Every pass reads the
+// points once and the memory does not depend on their number.
+std::unique_ptr<Mesh> make_approx_hull(const Points &_points,
+                                       size_t _max_vertices,
+                                       double _max_error = 0,
+                                       IExecutor *_exec = nullptr);
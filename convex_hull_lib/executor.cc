@@ -0,0 +1,184 @@
+#include "executor.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct SerialExecutor : public IExecutor {
+  void fork_join(const std::function<void()> &_a,
+                 const std::function<void()> &_b) override {
+    _a();
+    _b();
+  }
+  size_t concurrency() const override { return 1; }
+};
+
+struct Task {
+  explicit Task(const std::function<void()> &_fn) : m_fn(_fn) {}
+  void run() {
+    try {
+      m_fn();
+    } catch (...) {
+      m_exc = std::current_exception();
+    }
+    m_done.store(true, std::memory_order_release);
+  }
+  const std::function<void()> &m_fn;
+  std::exception_ptr m_exc;
+  std::atomic<bool> m_done{false};
+};
+
+class ThreadPool;
+thread_local const ThreadPool *tl_pool = nullptr;
+thread_local size_t tl_queue = 0;
+
+// Each worker owns a deque: it pushes and pops its own tasks at the back and
+// idle threads steal from the front of the others. Threads that are not
+// workers of the pool share one more deque.
+class ThreadPool : public IExecutor {
+  struct Queue {
+    std::mutex m_mtx;
+    std::deque<Task *> m_tasks;
+  };
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::vector<std::thread> m_threads;
+  std::mutex m_sleep_mtx;
+  std::condition_variable m_sleep_cv;
+  std::atomic<size_t> m_pending{0};
+  bool m_stop = false;
+
+  size_t own_queue() const {
+    return tl_pool == this ? tl_queue : m_queues.size() - 1;
+  }
+
+  void push(size_t _q, Task *_task) {
+    {
+      std::lock_guard<std::mutex> lock(m_queues[_q]->m_mtx);
+      m_queues[_q]->m_tasks.push_back(_task);
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_sleep_mtx);
+      ++m_pending;
+    }
+    m_sleep_cv.notify_one();
+  }
+
+  Task *find_task(size_t _q) {
+    for (size_t i = 0; i < m_queues.size(); ++i) {
+      auto &queue = *m_queues[(_q + i) % m_queues.size()];
+      std::lock_guard<std::mutex> lock(queue.m_mtx);
+      if (queue.m_tasks.empty())
+        continue;
+      Task *task;
+      if (i == 0) {
+        task = queue.m_tasks.back();
+        queue.m_tasks.pop_back();
+      } else {
+        task = queue.m_tasks.front();
+        queue.m_tasks.pop_front();
+      }
+      --m_pending;
+      return task;
+    }
+    return nullptr;
+  }
+
+  void work(size_t _q) {
+    tl_pool = this;
+    tl_queue = _q;
+    for (;;) {
+      if (auto task = find_task(_q)) {
+        task->run();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(m_sleep_mtx);
+      m_sleep_cv.wait(lock, [this] { return m_stop || m_pending > 0; });
+      if (m_stop)
+        return;
+    }
+  }
+
+public:
+  explicit ThreadPool(size_t _thread_nmbr) {
+    // The thread calling fork_join() takes part in the work.
+    auto worker_nmbr = _thread_nmbr > 1 ? _thread_nmbr - 1 : 0;
+    for (size_t i = 0; i <= worker_nmbr; ++i)
+      m_queues.emplace_back(std::make_unique<Queue>());
+    for (size_t i = 0; i < worker_nmbr; ++i)
+      m_threads.emplace_back([this, i] { work(i); });
+  }
+
+  ~ThreadPool() override {
+    {
+      std::lock_guard<std::mutex> lock(m_sleep_mtx);
+      m_stop = true;
+    }
+    m_sleep_cv.notify_all();
+    for (auto &thrd : m_threads)
+      thrd.join();
+  }
+
+  void fork_join(const std::function<void()> &_a,
+                 const std::function<void()> &_b) override {
+    Task task_b(_b);
+    auto q = own_queue();
+    push(q, &task_b);
+    std::exception_ptr exc_a;
+    try {
+      _a();
+    } catch (...) {
+      exc_a = std::current_exception();
+    }
+    // Runs _b here if nobody stole it, otherwise helps with other tasks
+    // until the thief is done.
+    while (!task_b.m_done.load(std::memory_order_acquire)) {
+      if (auto task = find_task(q))
+        task->run();
+      else
+        std::this_thread::yield();
+    }
+    if (exc_a)
+      std::rethrow_exception(exc_a);
+    if (task_b.m_exc)
+      std::rethrow_exception(task_b.m_exc);
+  }
+
+  size_t concurrency() const override { return m_threads.size() + 1; }
+};
+
+} // namespace
+
+std::shared_ptr<IExecutor> IExecutor::make_serial() {
+  return std::make_shared<SerialExecutor>();
+}
+
+std::shared_ptr<IExecutor> IExecutor::make_thread_pool(size_t _thread_nmbr) {
+  if (_thread_nmbr == 0)
+    _thread_nmbr = std::max(1u, std::thread::hardware_concurrency());
+  return std::make_shared<ThreadPool>(_thread_nmbr);
+}
+
+static void parallel_for(IExecutor *_exec, size_t _begin, size_t _end,
+                         size_t _grain,
+                         const std::function<void(size_t, size_t)> &_fn) {
+  if (_exec == nullptr || _end - _begin <= _grain) {
+    _fn(_begin, _end);
+    return;
+  }
+  auto mid = _begin + (_end - _begin) / 2;
+  _exec->fork_join([&] { parallel_for(_exec, _begin, mid, _grain, _fn); },
+                   [&] { parallel_for(_exec, mid, _end, _grain, _fn); });
+}
+
+void parallel_for(IExecutor *_exec, size_t _size, size_t _grain,
+                  const std::function<void(size_t, size_t)> &_fn) {
+  if (_size > 0)
+    parallel_for(_exec, 0, _size, std::max<size_t>(_grain, 1), _fn);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+// Runs the independent sub-tasks of the hull engine.
+struct IExecutor {
+  virtual ~IExecutor() = default;
+
+  // Runs _a and _b, possibly concurrently, and returns when both are done.
+  // An exception thrown by one of the tasks is rethrown to the caller.
+  virtual void fork_join(const std::function<void()> &_a,
+                         const std::function<void()> &_b) = 0;
+
+  // Number of threads that can run tasks at the same time.
+  virtual size_t concurrency() const = 0;
+
+  static std::shared_ptr<IExecutor> make_serial();
+  // Work-stealing thread pool. With _thread_nmbr == 0 it uses one thread per
+  // hardware core.
+  static std::shared_ptr<IExecutor> make_thread_pool(size_t _thread_nmbr = 0);
+};
+
+// Calls _fn(begin, end) on consecutive sub-ranges of [0, _size) with about
+// _grain elements each. The calls run in parallel when _exec is given.
+void parallel_for(IExecutor *_exec, size_t _size, size_t _grain,
+                  const std::function<void(size_t, size_t)> &_fn);
@@ -0,0 +1,78 @@
+#include "file_mapping.hh"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileMapping::FileMapping(const std::string &_flnm) {
+  const void *addr = nullptr;
+#ifdef _WIN32
+  m_file = CreateFileA(_flnm.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (m_file == INVALID_HANDLE_VALUE) {
+    m_file = nullptr;
+    throw "Error";
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(m_file, &file_size)) {
+    close();
+    throw "Error";
+  }
+  m_size = static_cast<size_t>(file_size.QuadPart);
+  if (m_size > 0) {
+    m_mapping =
+        CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping != nullptr)
+      addr = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+  }
+#else
+  m_file = open(_flnm.c_str(), O_RDONLY);
+  if (m_file < 0)
+    throw "Error";
+  struct stat st;
+  if (fstat(m_file, &st) != 0) {
+    close();
+    throw "Error";
+  }
+  m_size = static_cast<size_t>(st.st_size);
+  if (m_size > 0) {
+    addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+    if (addr == MAP_FAILED)
+      addr = nullptr;
+    else
+      madvise(const_cast<void *>(addr), m_size, MADV_SEQUENTIAL);
+  }
+#endif
+  m_data = static_cast<const char *>(addr);
+  if (m_size > 0 && m_data == nullptr) {
+    close();
+    throw "Error";
+  }
+}
+
+FileMapping::~FileMapping() { close(); }
+
+void FileMapping::close() {
+#ifdef _WIN32
+  if (m_data != nullptr)
+    UnmapViewOfFile(m_data);
+  if (m_mapping != nullptr)
+    CloseHandle(m_mapping);
+  if (m_file != nullptr)
+    CloseHandle(m_file);
+  m_mapping = m_file = nullptr;
+#else
+  if (m_data != nullptr)
+    munmap(const_cast<char *>(m_data), m_size);
+  if (m_file >= 0)
+    ::close(m_file);
+  m_file = -1;
+#endif
+  m_data = nullptr;
+}
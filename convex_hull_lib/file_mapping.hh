@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// True if the host stores the least significant byte first, the byte order
+// of the binary point files.
+inline bool little_endian_host() {
+  const uint16_t one = 1;
+  return *reinterpret_cast<const char *>(&one) == 1;
+}
+
+// Reverses the bytes of _val, from one byte order to the other.
+template <class ValT> void swap_bytes(ValT &_val) {
+  auto bytes = reinterpret_cast<char *>(&_val);
+  std::reverse(bytes, bytes + sizeof(ValT));
+}
+
+// Read only memory mapping of a whole file. An empty file maps to null.
+class FileMapping {
+public:
+  explicit FileMapping(const std::string &_flnm);
+  ~FileMapping();
+  FileMapping(const FileMapping &) = delete;
+  FileMapping &operator=(const FileMapping &) = delete;
+
+  const char *data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+private:
+  void close();
+
+  const char *m_data = nullptr;
+  size_t m_size = 0;
+#ifdef _WIN32
+  void *m_file = nullptr;
+  void *m_mapping = nullptr;
+#else
+  int m_file = -1;
+#endif
+};
@@ -0,0 +1,117 @@
+#include "hull_batch.hh"
+#include "quick_hull.hh"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+// Sets hulled by one task at a time.
+const size_t SETS_PER_TASK = 64;
+const VertIdx UNMAPPED = std::numeric_limits<VertIdx>::max();
+
+// Hulls of consecutive sets, waiting to be copied in the batch.
+struct BatchBlock {
+  size_t m_first_set = 0;
+  std::vector<Geo::VectorD3> m_verts;
+  std::vector<std::array<VertIdx, 3>> m_faces;
+  // Vertices and triangles of every set of the block.
+  std::vector<std::array<size_t, 2>> m_sizes;
+};
+
+template <class SetFn>
+HullBatch make_batch(size_t _set_nmbr, const SetFn &_set,
+                     const HullOptions &_opts) {
+  std::mutex mtx;
+  std::vector<std::unique_ptr<BatchBlock>> blocks;
+  parallel_for(
+      _opts.m_executor.get(), _set_nmbr, SETS_PER_TASK,
+      [&](size_t _begin, size_t _end) {
+        auto block = std::make_unique<BatchBlock>();
+        block->m_first_set = _begin;
+        QuickHull hull;
+        Mesh flat;
+        std::vector<VertIdx> vert_map;
+        for (auto i = _begin; i < _end; ++i) {
+          IndexRange<const Geo::VectorD3> pts = _set(i);
+          auto vert_nmbr = block->m_verts.size();
+          auto face_nmbr = block->m_faces.size();
+          if (hull.build(pts.begin(), pts.size())) {
+            VertIdx local_nmbr = 0;
+            vert_map.assign(hull.vertices().size(), UNMAPPED);
+            for (const auto &face : hull.faces()) {
+              if (!face.m_alive)
+                continue;
+              auto &tri = block->m_faces.emplace_back();
+              for (size_t j = 0; j < 3; ++j) {
+                auto &v = vert_map[face.m_vert[j]];
+                if (v == UNMAPPED) {
+                  v = local_nmbr++;
+                  block->m_verts.push_back(hull.vertices()[face.m_vert[j]]);
+                }
+                tri[j] = v;
+              }
+            }
+          } else {
+            make_flat_hull(pts.begin(), pts.size(), hull.tolerance(), flat);
+            block->m_verts.insert(block->m_verts.end(), flat.m_pts.begin(),
+                                  flat.m_pts.end());
+          }
+          block->m_sizes.push_back({block->m_verts.size() - vert_nmbr,
+                                    block->m_faces.size() - face_nmbr});
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        blocks.push_back(std::move(block));
+      });
+
+  HullBatch batch;
+  batch.m_vert_offsets.assign(_set_nmbr + 1, 0);
+  batch.m_face_offsets.assign(_set_nmbr + 1, 0);
+  for (const auto &block : blocks) {
+    for (size_t k = 0; k < block->m_sizes.size(); ++k) {
+      batch.m_vert_offsets[block->m_first_set + k + 1] = block->m_sizes[k][0];
+      batch.m_face_offsets[block->m_first_set + k + 1] = block->m_sizes[k][1];
+    }
+  }
+  for (size_t i = 0; i < _set_nmbr; ++i) {
+    batch.m_vert_offsets[i + 1] += batch.m_vert_offsets[i];
+    batch.m_face_offsets[i + 1] += batch.m_face_offsets[i];
+  }
+  batch.m_verts.resize(batch.m_vert_offsets.back());
+  batch.m_faces.resize(batch.m_face_offsets.back());
+  parallel_for(_opts.m_executor.get(), blocks.size(), 1,
+               [&](size_t _begin, size_t _end) {
+                 for (auto b = _begin; b < _end; ++b) {
+                   const auto &block = *blocks[b];
+                   std::copy(block.m_verts.begin(), block.m_verts.end(),
+                             batch.m_verts.begin() +
+                                 batch.m_vert_offsets[block.m_first_set]);
+                   std::copy(block.m_faces.begin(), block.m_faces.end(),
+                             batch.m_faces.begin() +
+                                 batch.m_face_offsets[block.m_first_set]);
+                 }
+               });
+  return batch;
+}
+
+} // namespace
+
+HullBatch
+make_convex_hulls(const std::vector<IndexRange<const Geo::VectorD3>> &_sets,
+                  const HullOptions &_opts) {
+  return make_batch(
+      _sets.size(), [&_sets](size_t _i) { return _sets[_i]; }, _opts);
+}
+
+HullBatch make_convex_hulls(const Geo::VectorD3 *_pts, const size_t *_offsets,
+                            size_t _set_nmbr, const HullOptions &_opts) {
+  return make_batch(
+      _set_nmbr,
+      [_pts, _offsets](size_t _i) {
+        return IndexRange<const Geo::VectorD3>{_pts + _offsets[_i],
+                                               _pts + _offsets[_i + 1]};
+      },
+      _opts);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "point_hull.hh"
+
+#include <array>
+#include <vector>
+
+// Hulls of many point sets in contiguous buffers. Hull i has the vertices
+// [m_vert_offsets[i], m_vert_offsets[i + 1]) of m_verts and the triangles
+// [m_face_offsets[i], m_face_offsets[i + 1]) of m_faces, counterclockwise
+// seen from outside. The indices of a triangle are relative to the first
+// vertex of its hull. Flat sets have vertices but no triangles.
+struct HullBatch {
+  std::vector<Geo::VectorD3> m_verts;
+  std::vector<std::array<VertIdx, 3>> m_faces;
+  std::vector<size_t> m_vert_offsets;
+  std::vector<size_t> m_face_offsets;
+
+  size_t size() const {
+    return m_vert_offsets.empty() ? 0 : m_vert_offsets.size() - 1;
+  }
+};
+
+// Hulls every set with quickhull. The sets are split among the tasks of
+// _opts.m_executor, each reusing its buffers from one set to the next; the
+// other options are ignored.
+HullBatch
+make_convex_hulls(const std::vector<IndexRange<const Geo::VectorD3>> &_sets,
+                  const HullOptions &_opts = HullOptions());
+
+// Set i is [_offsets[i], _offsets[i + 1]) of _pts: _offsets has _set_nmbr + 1
+// entries.
+HullBatch make_convex_hulls(const Geo::VectorD3 *_pts, const size_t *_offsets,
+                            size_t _set_nmbr,
+                            const HullOptions &_opts = HullOptions());
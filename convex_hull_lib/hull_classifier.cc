@@ -0,0 +1,398 @@
+#include "hull_classifier.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CLASSIFIER_SSE2
+#endif
+
+namespace {
+
+// Hulls with up to this many planes test them all.
+const size_t SMALL_HULL_PLANES = 48;
+// The cells of the grid on a cube face aim at LEAF_PLANES planes, up to
+// MAX_RESOLUTION along a side. Cells with more planes are split in 4, down
+// to the depth MAX_DEPTH.
+const size_t LEAF_PLANES = 8;
+const size_t MAX_RESOLUTION = 256;
+const size_t MAX_DEPTH = 8;
+// The cells of a face are widened by this fraction: a point that rounding
+// puts in the next cell still finds the face.
+const double CELL_MARGIN = 1e-9;
+
+// Coordinate on a cube face of the side _i of the cells of a grid _res x _res
+// over [-1, 1]^2.
+double grid_coord(size_t _i, size_t _res) {
+  return -1 + 2 * double(_i) / double(_res);
+}
+
+// Cell of a grid _res x _res over [-1, 1]^2 that has the coordinate _coord.
+size_t grid_cell(double _coord, size_t _res) {
+  auto pos = (_coord + 1) / 2 * double(_res);
+  return std::min(_res - 1, size_t(std::max(0., pos)));
+}
+
+// Convex polygon clipped against planes through the origin.
+struct ClipPolygon {
+  std::array<Geo::VectorD3, 8> m_pts;
+  size_t m_size = 0;
+
+  // Keeps the part with _nrm * x >= 0.
+  void clip(const Geo::VectorD3 &_nrm) {
+    std::array<Geo::VectorD3, 8> res;
+    size_t res_size = 0;
+    for (size_t i = 0; i < m_size; ++i) {
+      const auto &a = m_pts[i], &b = m_pts[(i + 1) % m_size];
+      auto da = _nrm * a, db = _nrm * b;
+      if (da >= 0)
+        res[res_size++] = a;
+      if ((da < 0) != (db < 0))
+        res[res_size++] = a + (da / (da - db)) * (b - a);
+    }
+    m_pts = res;
+    m_size = res_size;
+  }
+};
+
+} // namespace
+
+HullClassifier::HullClassifier(const Mesh &_mesh, double _tol) : m_tol(_tol) {
+  const auto &faces = _mesh.m_faces;
+  if (faces.empty())
+    return;
+  // Faces on the same plane share it.
+  struct PlaneKey {
+    Geo::VectorD3 m_normal;
+    double m_dist;
+    VertIdx m_face;
+    bool same_plane(const PlaneKey &_oth) const {
+      return m_normal == _oth.m_normal && m_dist == _oth.m_dist;
+    }
+  };
+  std::vector<PlaneKey> keys(faces.size());
+  for (size_t f = 0; f < faces.size(); ++f)
+    keys[f] = {faces[f].m_normal, faces[f].m_dist, VertIdx(f)};
+  std::sort(keys.begin(), keys.end(),
+            [](const PlaneKey &_a, const PlaneKey &_b) {
+              if (_a.m_normal != _b.m_normal)
+                return _a.m_normal < _b.m_normal;
+              return _a.m_dist < _b.m_dist;
+            });
+  std::vector<VertIdx> plane_of(faces.size());
+  // Minus the area and the index of every plane.
+  std::vector<std::pair<double, VertIdx>> by_area;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (i == 0 || !keys[i - 1].same_plane(keys[i]))
+      by_area.push_back({0, VertIdx(by_area.size())});
+    auto f = keys[i].m_face;
+    plane_of[f] = by_area.back().second;
+    const auto &vert = faces[f].m_vert;
+    by_area.back().first -=
+        Geo::length((_mesh.point(vert[1]) - _mesh.point(vert[0])) %
+                    (_mesh.point(vert[2]) - _mesh.point(vert[0])));
+  }
+  m_plane_nmbr = by_area.size();
+  // The planes are numbered in the order of decreasing area, order has a
+  // face of every one.
+  std::vector<size_t> plane_face(m_plane_nmbr);
+  for (size_t i = 0; i < keys.size(); ++i)
+    plane_face[plane_of[keys[i].m_face]] = keys[i].m_face;
+  std::sort(by_area.begin(), by_area.end());
+  std::vector<VertIdx> rank(m_plane_nmbr);
+  std::vector<size_t> order(m_plane_nmbr);
+  for (size_t i = 0; i < m_plane_nmbr; ++i) {
+    rank[by_area[i].second] = VertIdx(i);
+    order[i] = plane_face[by_area[i].second];
+  }
+  for (auto &plane : plane_of)
+    plane = rank[plane];
+
+  size_t vert_nmbr = 0;
+  for (const auto &face : faces) {
+    for (auto v : face.m_vert)
+      m_center += _mesh.point(v);
+    vert_nmbr += 3;
+  }
+  m_center /= double(vert_nmbr);
+  // The directions are measured in the box scaled to a cube, so that the
+  // cells of a flat hull see few faces too.
+  Geo::Range<3> box;
+  for (const auto &face : faces) {
+    for (auto v : face.m_vert)
+      box += _mesh.point(v);
+  }
+  for (size_t c = 0; c < 3; ++c) {
+    auto len = box[1][c] - box[0][c];
+    m_scale[c] = len > 0 ? 1 / len : 1;
+  }
+
+  m_cell_off.push_back(0);
+  if (m_plane_nmbr <= SMALL_HULL_PLANES) {
+    std::vector<VertIdx> all(m_plane_nmbr);
+    std::iota(all.begin(), all.end(), 0);
+    add_cell(all, faces, order);
+    return;
+  }
+
+  // The part of every face in the pyramid of every cube face, slightly
+  // widened, seen from the center and projected on the cube face.
+  std::array<std::vector<CellEntry>, 6> entries;
+  for (size_t f = 0; f < faces.size(); ++f) {
+    ClipPolygon tri;
+    for (auto w : faces[f].m_vert)
+      tri.m_pts[tri.m_size++] = scaled(_mesh.point(w));
+    // Most faces are inside the narrowed pyramid of one cube face, so they
+    // are not in the others.
+    size_t only_face = 6;
+    for (size_t cube_face = 0; cube_face < 6; ++cube_face) {
+      auto a = cube_face / 2;
+      auto sgn = cube_face % 2 == 0 ? 1. : -1.;
+      bool inside = true;
+      for (size_t i = 0; i < 3; ++i) {
+        const auto &pt = tri.m_pts[i];
+        inside &= sgn * pt[a] > (1 + CELL_MARGIN) *
+                                    std::max(std::fabs(pt[(a + 1) % 3]),
+                                             std::fabs(pt[(a + 2) % 3]));
+      }
+      if (inside)
+        only_face = cube_face;
+    }
+    for (size_t cube_face = 0; cube_face < 6; ++cube_face) {
+      if (only_face != 6 && cube_face != only_face)
+        continue;
+      auto a = cube_face / 2, u = (a + 1) % 3, v = (a + 2) % 3;
+      auto sgn = cube_face % 2 == 0 ? 1. : -1.;
+      auto poly = tri;
+      if (only_face == 6) {
+        for (auto c : {u, v}) {
+          for (double side : {1., -1.}) {
+            Geo::VectorD3 nrm{};
+            nrm[a] = sgn * (1 + CELL_MARGIN);
+            nrm[c] = side;
+            poly.clip(nrm);
+          }
+        }
+      }
+      if (poly.m_size == 0)
+        continue;
+      CellEntry entry{{1, 1}, {-1, -1}, plane_of[f]};
+      for (size_t i = 0; i < poly.m_size; ++i) {
+        const auto &pt = poly.m_pts[i];
+        auto dist = sgn * pt[a];
+        size_t k = 0;
+        for (auto c : {u, v}) {
+          auto coord = dist > 0 ? pt[c] / dist : 0;
+          entry.m_lo[k] = dist > 0 ? std::min(entry.m_lo[k], coord) : -1;
+          entry.m_hi[k] = dist > 0 ? std::max(entry.m_hi[k], coord) : 1;
+          ++k;
+        }
+      }
+      for (size_t k = 0; k < 2; ++k) {
+        entry.m_lo[k] -= CELL_MARGIN;
+        entry.m_hi[k] += CELL_MARGIN;
+      }
+      entries[cube_face].push_back(entry);
+    }
+  }
+  // A uniform grid on every cube face, then the quadtrees of its crowded
+  // cells.
+  m_res = std::min(MAX_RESOLUTION,
+                   size_t(std::ceil(std::sqrt(double(m_plane_nmbr) /
+                                              double(6 * LEAF_PLANES)))));
+  m_nodes.resize(6 * m_res * m_res);
+  std::vector<std::vector<CellEntry>> grid(m_res * m_res);
+  for (size_t cube_face = 0; cube_face < 6; ++cube_face) {
+    // One entry per plane, the larger first.
+    auto &list = entries[cube_face];
+    std::sort(list.begin(), list.end(),
+              [](const CellEntry &_a, const CellEntry &_b) {
+                return _a.m_plane < _b.m_plane;
+              });
+    size_t size = 0;
+    for (size_t i = 0; i < list.size(); ++i) {
+      if (size > 0 && list[size - 1].m_plane == list[i].m_plane) {
+        auto &last = list[size - 1];
+        for (size_t k = 0; k < 2; ++k) {
+          last.m_lo[k] = std::min(last.m_lo[k], list[i].m_lo[k]);
+          last.m_hi[k] = std::max(last.m_hi[k], list[i].m_hi[k]);
+        }
+      } else {
+        list[size++] = list[i];
+      }
+    }
+    list.resize(size);
+    for (auto &cell : grid)
+      cell.clear();
+    for (const auto &entry : list) {
+      auto i_end = grid_cell(entry.m_hi[0], m_res),
+           j_end = grid_cell(entry.m_hi[1], m_res);
+      for (auto i = grid_cell(entry.m_lo[0], m_res); i <= i_end; ++i) {
+        for (auto j = grid_cell(entry.m_lo[1], m_res); j <= j_end; ++j)
+          grid[i * m_res + j].push_back(entry);
+      }
+    }
+    for (size_t i = 0; i < m_res; ++i) {
+      for (size_t j = 0; j < m_res; ++j) {
+        split_cell((cube_face * m_res + i) * m_res + j, grid[i * m_res + j],
+                   {grid_coord(i, m_res), grid_coord(j, m_res)},
+                   {grid_coord(i + 1, m_res), grid_coord(j + 1, m_res)}, 0,
+                   faces, order);
+      }
+    }
+  }
+}
+
+void HullClassifier::split_cell(size_t _node,
+                                const std::vector<CellEntry> &_entries,
+                                std::array<double, 2> _lo,
+                                std::array<double, 2> _hi, size_t _depth,
+                                const std::pmr::vector<MeshFace> &_faces,
+                                const std::vector<size_t> &_order) {
+  std::array<std::vector<CellEntry>, 4> children;
+  bool split = _entries.size() > LEAF_PLANES && _depth < MAX_DEPTH;
+  if (split) {
+    double mid[2] = {(_lo[0] + _hi[0]) / 2, (_lo[1] + _hi[1]) / 2};
+    for (const auto &entry : _entries) {
+      for (size_t ch = 0; ch < 4; ++ch) {
+        bool overlap = true;
+        for (size_t k = 0; k < 2; ++k) {
+          auto upper = (ch >> k) & 1;
+          overlap &= upper ? entry.m_hi[k] >= mid[k] : entry.m_lo[k] <= mid[k];
+        }
+        if (overlap)
+          children[ch].push_back(entry);
+      }
+    }
+    // The faces larger than the children would be copied in all of them.
+    size_t copies = 0;
+    for (const auto &child : children)
+      copies += child.size();
+    split = copies <= 2 * _entries.size();
+  }
+  if (!split) {
+    std::vector<VertIdx> planes;
+    for (const auto &entry : _entries)
+      planes.push_back(entry.m_plane);
+    m_nodes[_node] = {0, VertIdx(add_cell(planes, _faces, _order))};
+    return;
+  }
+  auto first = m_nodes.size();
+  m_nodes.resize(first + 4);
+  m_nodes[_node].m_child = VertIdx(first);
+  for (size_t ch = 0; ch < 4; ++ch) {
+    auto lo = _lo, hi = _hi;
+    for (size_t k = 0; k < 2; ++k) {
+      auto mid = (_lo[k] + _hi[k]) / 2;
+      ((ch >> k) & 1 ? lo : hi)[k] = mid;
+    }
+    split_cell(first + ch, children[ch], lo, hi, _depth + 1, _faces, _order);
+  }
+}
+
+size_t HullClassifier::add_cell(const std::vector<VertIdx> &_planes,
+                                const std::pmr::vector<MeshFace> &_faces,
+                                const std::vector<size_t> &_order) {
+  for (size_t i = 0; i < _planes.size(); i += 4) {
+    std::array<double, 16> block;
+    for (size_t k = 0; k < 4; ++k) {
+      // The padding planes have no point beyond them.
+      MeshFace face{{}, {0, 0, 0}, std::numeric_limits<double>::max()};
+      if (i + k < _planes.size())
+        face = _faces[_order[_planes[i + k]]];
+      for (size_t c = 0; c < 3; ++c)
+        block[4 * c + k] = face.m_normal[c];
+      block[12 + k] = face.m_dist;
+    }
+    m_blocks.insert(m_blocks.end(), block.begin(), block.end());
+  }
+  m_cell_off.push_back(VertIdx(m_blocks.size() / 16));
+  return m_cell_off.size() - 2;
+}
+
+size_t HullClassifier::cell(const Geo::VectorD3 &_pt) const {
+  if (m_nodes.empty())
+    return 0;
+  auto dir = scaled(_pt);
+  size_t a = 0;
+  for (size_t c = 1; c < 3; ++c) {
+    if (std::fabs(dir[c]) > std::fabs(dir[a]))
+      a = c;
+  }
+  auto dist = std::fabs(dir[a]);
+  if (dist == 0)
+    dist = 1;
+  double coord[2] = {dir[(a + 1) % 3] / dist, dir[(a + 2) % 3] / dist};
+  auto i = grid_cell(coord[0], m_res), j = grid_cell(coord[1], m_res);
+  double lo[2] = {grid_coord(i, m_res), grid_coord(j, m_res)};
+  double hi[2] = {grid_coord(i + 1, m_res), grid_coord(j + 1, m_res)};
+  auto cube_face = 2 * a + (dir[a] > 0 ? 0 : 1);
+  auto node = m_nodes[(cube_face * m_res + i) * m_res + j];
+  while (node.m_child != 0) {
+    size_t ch = 0;
+    for (size_t k = 0; k < 2; ++k) {
+      auto mid = (lo[k] + hi[k]) / 2;
+      if (coord[k] >= mid) {
+        ch |= size_t(1) << k;
+        lo[k] = mid;
+      } else {
+        hi[k] = mid;
+      }
+    }
+    node = m_nodes[node.m_child + ch];
+  }
+  return node.m_cell;
+}
+
+bool HullClassifier::inside(const Geo::VectorD3 &_pt) const {
+  if (m_cell_off.empty())
+    return false;
+  auto c = cell(_pt);
+  auto beg = m_blocks.data() + 16 * size_t(m_cell_off[c]);
+  auto end = m_blocks.data() + 16 * size_t(m_cell_off[c + 1]);
+#ifdef CLASSIFIER_SSE2
+  auto x = _mm_set1_pd(_pt[0]), y = _mm_set1_pd(_pt[1]),
+       z = _mm_set1_pd(_pt[2]), tol = _mm_set1_pd(m_tol);
+  auto dist = [&](const double *_block) {
+    auto val = _mm_mul_pd(_mm_loadu_pd(_block), x);
+    val = _mm_add_pd(val, _mm_mul_pd(_mm_loadu_pd(_block + 4), y));
+    val = _mm_add_pd(val, _mm_mul_pd(_mm_loadu_pd(_block + 8), z));
+    return _mm_sub_pd(val, _mm_loadu_pd(_block + 12));
+  };
+  for (auto block = beg; block < end; block += 16) {
+    auto out = _mm_or_pd(_mm_cmpgt_pd(dist(block), tol),
+                         _mm_cmpgt_pd(dist(block + 2), tol));
+    if (_mm_movemask_pd(out) != 0)
+      return false;
+  }
+#else
+  for (auto block = beg; block < end; block += 16) {
+    for (size_t k = 0; k < 4; ++k) {
+      if (block[k] * _pt[0] + block[4 + k] * _pt[1] + block[8 + k] * _pt[2] -
+              block[12 + k] >
+          m_tol)
+        return false;
+    }
+  }
+#endif
+  return true;
+}
+
+size_t HullClassifier::classify(const Geo::VectorD3 *_pts, size_t _size,
+                                uint8_t *_inside, IExecutor *_exec) const {
+  std::atomic<size_t> inside_nmbr{0};
+  parallel_for(_exec, _size, 1 << 14, [&](size_t _b, size_t _e) {
+    size_t nmbr = 0;
+    for (auto i = _b; i < _e; ++i) {
+      _inside[i] = inside(_pts[i]) ? 1 : 0;
+      nmbr += _inside[i];
+    }
+    inside_nmbr += nmbr;
+  });
+  return inside_nmbr;
+}
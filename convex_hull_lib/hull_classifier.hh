@@ -0,0 +1,82 @@
+#pragma once
+
+#include "point_hull.hh"
+
+#include <array>
+#include <vector>
+
+// Inside or outside tests of many points against a hull. The face planes are
+// in structure of arrays layout, in blocks of 4, and a point is tested
+// against a block at a time, stopping at the first plane it is beyond; the
+// faces of larger area, that reject the most points, come first. The planes
+// of a large hull are split in the cells of a cube map around an inner
+// point, with the box of the hull scaled to a cube: a point is inside the
+// hull if it is inside the planes of the faces that the cell of its
+// direction sees, so it never reads the others. Every face of the cube is a
+// grid of quadtrees, that split the cells seeing many faces.
+// The queries do not change the object and can run from many threads.
+class HullClassifier {
+public:
+  // Uses the faces of _mesh: a mesh without faces contains no point. A point
+  // is inside if it is at most _tol beyond every face plane.
+  explicit HullClassifier(const Mesh &_mesh, double _tol = 0);
+
+  bool inside(const Geo::VectorD3 &_pt) const;
+  // Sets _inside[i] to 1 if _pts[i] is inside, to 0 otherwise. The points
+  // are split among the tasks of _exec when given. Returns the number of
+  // points inside.
+  size_t classify(const Geo::VectorD3 *_pts, size_t _size, uint8_t *_inside,
+                  IExecutor *_exec = nullptr) const;
+
+  size_t planes() const { return m_plane_nmbr; }
+  size_t cells() const {
+    return m_cell_off.empty() ? 0 : m_cell_off.size() - 1;
+  }
+
+private:
+  // Node of the quadtree of a cell of the grid. The children of an inner
+  // node are m_child, ..., m_child + 3: child k is on the upper side of the
+  // first coordinate if bit 0 of k is set, of the second one if bit 1 is
+  // set.
+  struct QuadNode {
+    VertIdx m_child = 0;
+    VertIdx m_cell = 0;
+  };
+  // Projection on a cube face of the part of a plane it sees.
+  struct CellEntry {
+    std::array<double, 2> m_lo, m_hi;
+    VertIdx m_plane;
+  };
+
+  Geo::VectorD3 scaled(const Geo::VectorD3 &_pt) const {
+    return {(_pt[0] - m_center[0]) * m_scale[0],
+            (_pt[1] - m_center[1]) * m_scale[1],
+            (_pt[2] - m_center[2]) * m_scale[2]};
+  }
+  size_t cell(const Geo::VectorD3 &_pt) const;
+  // Makes _node a leaf with _entries or splits it. _order has the face of
+  // every plane.
+  void split_cell(size_t _node, const std::vector<CellEntry> &_entries,
+                  std::array<double, 2> _lo, std::array<double, 2> _hi,
+                  size_t _depth, const std::pmr::vector<MeshFace> &_faces,
+                  const std::vector<size_t> &_order);
+  // Appends a cell with the planes _planes and returns its index.
+  size_t add_cell(const std::vector<VertIdx> &_planes,
+                  const std::pmr::vector<MeshFace> &_faces,
+                  const std::vector<size_t> &_order);
+
+  double m_tol = 0;
+  size_t m_plane_nmbr = 0;
+  // Cells along the side of the grid on a cube face.
+  size_t m_res = 0;
+  Geo::VectorD3 m_center{};
+  Geo::VectorD3 m_scale{};
+  // The planes in blocks of 4: the x of their normals, then the y, the z
+  // and the distances. The planes of cell c are the blocks
+  // [m_cell_off[c], m_cell_off[c + 1]).
+  std::vector<double> m_blocks;
+  std::vector<VertIdx> m_cell_off;
+  // The roots of the cells of the grids come first, cube face after cube
+  // face and row after row. No nodes for a single cell.
+  std::vector<QuadNode> m_nodes;
+};
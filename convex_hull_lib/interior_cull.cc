@@ -0,0 +1,225 @@
+#include "interior_cull.hh"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CULL_SSE2
+#endif
+
+namespace {
+
+// Axes of the 26 directions: 3 coordinate axes, 4 cube diagonals and 6 face
+// diagonals. The first 3, 7 or 13 of them give 6, 14 or 26 directions.
+const Geo::VectorD3 AXES[] = {
+    {1, 0, 0},  {0, 1, 0},  {0, 0, 1},  {1, 1, 1},  {1, 1, -1},
+    {1, -1, 1}, {1, -1, -1}, {1, 1, 0}, {1, -1, 0}, {1, 0, 1},
+    {1, 0, -1}, {0, 1, 1},  {0, 1, -1}};
+const size_t MAX_AXES = std::size(AXES);
+
+// Polytope planes in structure of arrays layout, padded with planes that
+// contain everything so that they can be tested in pairs.
+const size_t MAX_PLANES = 64;
+struct Planes {
+  alignas(32) double m_nx[MAX_PLANES];
+  alignas(32) double m_ny[MAX_PLANES];
+  alignas(32) double m_nz[MAX_PLANES];
+  alignas(32) double m_d[MAX_PLANES];
+  size_t m_nmbr = 0;
+
+  Planes() {
+    std::fill(std::begin(m_nx), std::end(m_nx), 0.);
+    std::fill(std::begin(m_ny), std::end(m_ny), 0.);
+    std::fill(std::begin(m_nz), std::end(m_nz), 0.);
+    std::fill(std::begin(m_d), std::end(m_d),
+              std::numeric_limits<double>::infinity());
+  }
+
+  bool strictly_inside(const Geo::VectorD3 &_pt) const {
+    // The padding makes the plane number even.
+    auto plane_nmbr = (m_nmbr + 1) & ~size_t(1);
+#ifdef CULL_SSE2
+    auto x = _mm_set1_pd(_pt[0]);
+    auto y = _mm_set1_pd(_pt[1]);
+    auto z = _mm_set1_pd(_pt[2]);
+    auto inside = _mm_cmpeq_pd(x, x);
+    for (size_t i = 0; i < plane_nmbr; i += 2) {
+      auto dist = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_load_pd(m_nx + i), x),
+                                        _mm_mul_pd(_mm_load_pd(m_ny + i), y)),
+                             _mm_mul_pd(_mm_load_pd(m_nz + i), z));
+      inside = _mm_and_pd(inside, _mm_cmplt_pd(dist, _mm_load_pd(m_d + i)));
+    }
+    return _mm_movemask_pd(inside) == 3;
+#else
+    bool inside = true;
+    for (size_t i = 0; i < plane_nmbr; ++i)
+      inside &= m_nx[i] * _pt[0] + m_ny[i] * _pt[1] + m_nz[i] * _pt[2] < m_d[i];
+    return inside;
+#endif
+  }
+};
+
+struct Extremes {
+  double m_val[MAX_AXES][2];
+  size_t m_idx[MAX_AXES][2];
+
+  Extremes() {
+    for (size_t i = 0; i < MAX_AXES; ++i) {
+      m_val[i][0] = std::numeric_limits<double>::max();
+      m_val[i][1] = std::numeric_limits<double>::lowest();
+      m_idx[i][0] = m_idx[i][1] = 0;
+    }
+  }
+
+  void add(const Extremes &_oth, size_t _axes) {
+    for (size_t i = 0; i < _axes; ++i) {
+      if (_oth.m_val[i][0] < m_val[i][0]) {
+        m_val[i][0] = _oth.m_val[i][0];
+        m_idx[i][0] = _oth.m_idx[i][0];
+      }
+      if (_oth.m_val[i][1] > m_val[i][1]) {
+        m_val[i][1] = _oth.m_val[i][1];
+        m_idx[i][1] = _oth.m_idx[i][1];
+      }
+    }
+  }
+};
+
+// Planes of the facets of the hull of a few points, found by brute force.
+// Returns false if the points are not spread in 3 dimensions.
+bool facet_planes(const std::vector<Geo::VectorD3> &_pts, Planes &_planes) {
+  double scale = 0;
+  for (const auto &pt : _pts)
+    scale = std::max(scale, Geo::length(pt));
+  auto tol = Geo::epsilon(scale);
+  auto size = _pts.size();
+  for (size_t i = 0; i < size; ++i) {
+    for (size_t j = i + 1; j < size; ++j) {
+      for (size_t k = j + 1; k < size; ++k) {
+        auto norm = (_pts[j] - _pts[i]) % (_pts[k] - _pts[i]);
+        auto len = Geo::length(norm);
+        if (len <= tol * scale)
+          continue;
+        norm /= len;
+        auto d = norm * _pts[i];
+        bool below = false, above = false;
+        for (const auto &pt : _pts) {
+          auto dist = norm * pt - d;
+          below |= dist < -tol;
+          above |= dist > tol;
+        }
+        if (below == above)
+          continue;
+        if (above) {
+          norm = -norm;
+          d = -d;
+        }
+        bool known = false;
+        for (size_t l = 0; l < _planes.m_nmbr && !known; ++l) {
+          known = std::fabs(_planes.m_d[l] + tol - d) <= tol &&
+                  Geo::length_square(Geo::VectorD3{_planes.m_nx[l],
+                                                   _planes.m_ny[l],
+                                                   _planes.m_nz[l]} -
+                                     norm) <= Geo::sq(tol);
+        }
+        if (known)
+          continue;
+        if (_planes.m_nmbr == MAX_PLANES)
+          return false;
+        auto l = _planes.m_nmbr++;
+        _planes.m_nx[l] = norm[0];
+        _planes.m_ny[l] = norm[1];
+        _planes.m_nz[l] = norm[2];
+        // Only the points farther than tol from the plane are inside.
+        _planes.m_d[l] = d - tol;
+      }
+    }
+  }
+  return _planes.m_nmbr >= 4;
+}
+
+} // namespace
+
+size_t cull_interior_points(std::vector<Geo::VectorD3>::iterator _begin,
+                            std::vector<Geo::VectorD3>::iterator _end,
+                            size_t _dir_nmbr, IExecutor *_exec) {
+  const size_t GRAIN = 1 << 16;
+  auto size = static_cast<size_t>(_end - _begin);
+  auto axes = std::min(_dir_nmbr / 2, MAX_AXES);
+  if (size < 8 || axes < 3)
+    return 0;
+  // parallel_for splits the range in halves, so the chunks do not start at
+  // multiples of GRAIN: each one finds its own extremes and adds them.
+  Extremes extr;
+  std::mutex mtx;
+  parallel_for(_exec, size, GRAIN, [&](size_t _b, size_t _e) {
+    Extremes chunk_extr;
+    for (auto i = _b; i < _e; ++i) {
+      const auto &pt = _begin[i];
+      for (size_t j = 0; j < axes; ++j) {
+        auto val = AXES[j] * pt;
+        if (val < chunk_extr.m_val[j][0]) {
+          chunk_extr.m_val[j][0] = val;
+          chunk_extr.m_idx[j][0] = i;
+        }
+        if (val > chunk_extr.m_val[j][1]) {
+          chunk_extr.m_val[j][1] = val;
+          chunk_extr.m_idx[j][1] = i;
+        }
+      }
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    extr.add(chunk_extr, axes);
+  });
+  std::vector<size_t> extr_idx;
+  for (size_t j = 0; j < axes; ++j)
+    extr_idx.insert(extr_idx.end(), {extr.m_idx[j][0], extr.m_idx[j][1]});
+  std::sort(extr_idx.begin(), extr_idx.end());
+  extr_idx.erase(std::unique(extr_idx.begin(), extr_idx.end()),
+                 extr_idx.end());
+  std::vector<Geo::VectorD3> extr_pts;
+  for (auto idx : extr_idx)
+    extr_pts.push_back(_begin[idx]);
+  Planes planes;
+  if (!facet_planes(extr_pts, planes))
+    return 0;
+
+  // Fixed blocks of GRAIN points: a prefix sum of their counts gives where
+  // each one writes its kept and its culled points, so the parallel scatter
+  // keeps the order of both.
+  auto block_nmbr = (size + GRAIN - 1) / GRAIN;
+  std::vector<char> keep(size);
+  std::vector<size_t> kept_off(block_nmbr + 1, 0);
+  parallel_for(_exec, block_nmbr, 1, [&](size_t _b, size_t _e) {
+    for (auto blk = _b; blk < _e; ++blk) {
+      size_t nmbr = 0;
+      for (auto i = blk * GRAIN; i < std::min(size, (blk + 1) * GRAIN); ++i) {
+        keep[i] = !planes.strictly_inside(_begin[i]);
+        nmbr += keep[i];
+      }
+      kept_off[blk + 1] = nmbr;
+    }
+  });
+  std::partial_sum(kept_off.begin(), kept_off.end(), kept_off.begin());
+  auto kept = kept_off.back();
+  if (kept == size)
+    return 0;
+  // Not zeroed: the scatter writes every point.
+  std::unique_ptr<Geo::VectorD3[]> parted(new Geo::VectorD3[size]);
+  parallel_for(_exec, block_nmbr, 1, [&](size_t _b, size_t _e) {
+    for (auto blk = _b; blk < _e; ++blk) {
+      auto kept_pos = kept_off[blk];
+      auto culled_pos = kept + blk * GRAIN - kept_off[blk];
+      for (auto i = blk * GRAIN; i < std::min(size, (blk + 1) * GRAIN); ++i)
+        parted[keep[i] ? kept_pos++ : culled_pos++] = _begin[i];
+    }
+  });
+  parallel_for(_exec, size, GRAIN, [&](size_t _b, size_t _e) {
+    std::copy(parted.get() + _b, parted.get() + _e, _begin + _b);
+  });
+  return size - kept;
+}
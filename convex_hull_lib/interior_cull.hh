@@ -0,0 +1,16 @@
+#pragma once
+
+#include "executor.hh"
+#include "vector.hh"
+
+#include <vector>
+
+// Akl-Toussaint filter. Finds the extreme points of [_begin, _end) along
+// _dir_nmbr directions (6, 14 or 26) and moves to the end of the range the
+// points strictly inside the polytope they span. Both parts keep the order
+// of the points; the move goes through a copy of the range. Returns how many
+// points were moved. The polytope is inside the hull, so the moved points cannot be
+// hull vertices.
+size_t cull_interior_points(std::vector<Geo::VectorD3>::iterator _begin,
+                            std::vector<Geo::VectorD3>::iterator _end,
+                            size_t _dir_nmbr, IExecutor *_exec = nullptr);
@@ -0,0 +1,141 @@
+#include "mesh_writer.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+class BufferedWriter {
+public:
+  explicit BufferedWriter(const std::string &_flnm)
+      : m_file(_flnm, std::ios::binary) {
+    if (!m_file)
+      throw "Error";
+    m_buf.resize(BUF_SIZE);
+  }
+  ~BufferedWriter() { flush(); }
+
+  void put(const char *_str) { put(_str, std::strlen(_str)); }
+  void put(const char *_data, size_t _size) {
+    if (m_pos + _size > m_buf.size()) {
+      flush();
+      if (_size > m_buf.size()) {
+        m_file.write(_data, _size);
+        return;
+      }
+    }
+    std::memcpy(m_buf.data() + m_pos, _data, _size);
+    m_pos += _size;
+  }
+  template <class ValT> void put_text(ValT _val) {
+    reserve(MAX_NUMBER);
+    auto res = std::to_chars(m_buf.data() + m_pos, m_buf.data() + m_buf.size(),
+                             _val);
+    m_pos = res.ptr - m_buf.data();
+  }
+  // Little endian bytes of _val.
+  template <class ValT> void put_binary(ValT _val) {
+    char bytes[sizeof(ValT)];
+    std::memcpy(bytes, &_val, sizeof(ValT));
+    const uint16_t one = 1;
+    if (*reinterpret_cast<const char *>(&one) != 1)
+      std::reverse(bytes, bytes + sizeof(ValT));
+    put(bytes, sizeof(ValT));
+  }
+
+private:
+  static const size_t BUF_SIZE = 1 << 20;
+  static const size_t MAX_NUMBER = 32;
+
+  void reserve(size_t _size) {
+    if (m_pos + _size > m_buf.size())
+      flush();
+  }
+  void flush() {
+    m_file.write(m_buf.data(), m_pos);
+    m_pos = 0;
+  }
+
+  std::ofstream m_file;
+  std::vector<char> m_buf;
+  size_t m_pos = 0;
+};
+
+void save_obj(const Mesh &_mesh, BufferedWriter &_out) {
+  for (const auto &pt : _mesh.m_pts) {
+    _out.put("v");
+    for (auto coord : pt) {
+      _out.put(" ");
+      _out.put_text(coord);
+    }
+    _out.put("\n");
+  }
+  for (const auto &face : _mesh.m_faces) {
+    _out.put("f");
+    for (auto v : face.m_vert) {
+      _out.put(" ");
+      _out.put_text(v + 1);
+    }
+    _out.put("\n");
+  }
+}
+
+void save_ply(const Mesh &_mesh, BufferedWriter &_out) {
+  _out.put("ply\nformat binary_little_endian 1.0\nelement vertex ");
+  _out.put_text(_mesh.size());
+  _out.put("\nproperty double x\nproperty double y\nproperty double z\n"
+           "element face ");
+  _out.put_text(_mesh.m_faces.size());
+  _out.put("\nproperty list uchar uint vertex_indices\nend_header\n");
+  for (const auto &pt : _mesh.m_pts) {
+    for (auto coord : pt)
+      _out.put_binary(coord);
+  }
+  for (const auto &face : _mesh.m_faces) {
+    _out.put_binary(uint8_t(3));
+    for (auto v : face.m_vert)
+      _out.put_binary(uint32_t(v));
+  }
+}
+
+void save_stl(const Mesh &_mesh, BufferedWriter &_out) {
+  char header[80] = "binary STL";
+  _out.put(header, sizeof(header));
+  _out.put_binary(uint32_t(_mesh.m_faces.size()));
+  for (const auto &face : _mesh.m_faces) {
+    for (auto coord : face.m_normal)
+      _out.put_binary(float(coord));
+    for (auto v : face.m_vert) {
+      for (auto coord : _mesh.point(v))
+        _out.put_binary(float(coord));
+    }
+    _out.put_binary(uint16_t(0));
+  }
+}
+
+} // namespace
+
+MeshFormat mesh_format(const std::string &_flnm) {
+  auto dot = _flnm.find_last_of('.');
+  std::string ext = dot == std::string::npos ? "" : _flnm.substr(dot + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](char _c) { return char(std::tolower(_c)); });
+  if (ext == "ply")
+    return MeshFormat::PLY;
+  if (ext == "stl")
+    return MeshFormat::STL;
+  return MeshFormat::OBJ;
+}
+
+void save_mesh(const Mesh &_mesh, const std::string &_flnm,
+               MeshFormat _format) {
+  BufferedWriter out(_flnm);
+  switch (_format) {
+  case MeshFormat::OBJ: save_obj(_mesh, out); break;
+  case MeshFormat::PLY: save_ply(_mesh, out); break;
+  case MeshFormat::STL: save_stl(_mesh, out); break;
+  }
+}
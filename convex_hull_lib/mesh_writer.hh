@@ -0,0 +1,16 @@
+#pragma once
+
+#include "point_hull.hh"
+
+#include <string>
+
+enum class MeshFormat { OBJ, PLY, STL };
+
+// Format from the file extension. Unknown extensions give OBJ.
+MeshFormat mesh_format(const std::string &_flnm);
+
+// Writes the vertices and m_faces of _mesh: ASCII OBJ, binary little endian
+// PLY or binary STL. The output goes through a large buffer, the numbers
+// are formatted with std::to_chars.
+void save_mesh(const Mesh &_mesh, const std::string &_flnm,
+               MeshFormat _format);
@@ -0,0 +1,148 @@
+#include "point_file.hh"
+#include "quick_hull.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+static_assert(sizeof(PointFileHeader) == 24, "Header layout");
+static_assert(sizeof(Geo::VectorD3) == 3 * sizeof(double),
+              "Points are mapped in place");
+
+void save_point_file(const std::string &_flnm, const Geo::VectorD3 *_pts,
+                     size_t _size, bool _float32) {
+  std::ofstream f(_flnm, std::ios::binary);
+  if (!f)
+    throw "Error";
+  PointFileHeader header;
+  header.m_scalar_size = _float32 ? sizeof(float) : sizeof(double);
+  header.m_point_nmbr = _size;
+  auto little = little_endian_host();
+  if (!little) {
+    swap_bytes(header.m_version);
+    swap_bytes(header.m_scalar_size);
+    swap_bytes(header.m_point_nmbr);
+  }
+  f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (!_float32 && little) {
+    f.write(reinterpret_cast<const char *>(_pts), _size * sizeof(*_pts));
+    return;
+  }
+  auto put = [&f, little](auto _xyz) {
+    if (!little) {
+      for (auto &coord : _xyz)
+        swap_bytes(coord);
+    }
+    f.write(reinterpret_cast<const char *>(&_xyz), sizeof(_xyz));
+  };
+  for (size_t i = 0; i < _size; ++i) {
+    if (_float32)
+      put(Geo::VectorF3{float(_pts[i][0]), float(_pts[i][1]),
+                        float(_pts[i][2])});
+    else
+      put(_pts[i]);
+  }
+}
+
+MappedPointFile::MappedPointFile(const std::string &_flnm) : m_map(_flnm) {
+  if (m_map.size() < sizeof(PointFileHeader))
+    throw "Error";
+  std::memcpy(&m_header, m_map.data(), sizeof(PointFileHeader));
+  m_points = m_map.data() + sizeof(PointFileHeader);
+  if (!little_endian_host()) {
+    swap_bytes(m_header.m_version);
+    swap_bytes(m_header.m_scalar_size);
+    swap_bytes(m_header.m_reserved);
+    swap_bytes(m_header.m_point_nmbr);
+  }
+  if (std::memcmp(m_header.m_magic, PointFileHeader().m_magic, 4) != 0 ||
+      m_header.m_version != 1 ||
+      (m_header.m_scalar_size != sizeof(float) &&
+       m_header.m_scalar_size != sizeof(double)) ||
+      m_header.m_point_nmbr >
+          (m_map.size() - sizeof(PointFileHeader)) /
+              (3 * m_header.m_scalar_size))
+    throw "Error";
+}
+
+const Geo::VectorD3 *MappedPointFile::data() const {
+  if (is_float32() || !little_endian_host())
+    return nullptr;
+  return reinterpret_cast<const Geo::VectorD3 *>(m_points);
+}
+
+const Geo::VectorF3 *MappedPointFile::data_float32() const {
+  if (!is_float32() || !little_endian_host())
+    return nullptr;
+  return reinterpret_cast<const Geo::VectorF3 *>(m_points);
+}
+
+void MappedPointFile::copy(size_t _begin, size_t _end,
+                           Geo::VectorD3 *_out) const {
+  if (auto pts = data()) {
+    std::copy(pts + _begin, pts + _end, _out);
+    return;
+  }
+  if (auto pts = data_float32()) {
+    for (auto i = _begin; i < _end; ++i)
+      *_out++ = {pts[i][0], pts[i][1], pts[i][2]};
+    return;
+  }
+  auto read = [](const char *_p, auto _val) {
+    std::memcpy(&_val, _p, sizeof(_val));
+    swap_bytes(_val);
+    return double(_val);
+  };
+  auto scalar_size = m_header.m_scalar_size;
+  auto p = m_points + _begin * 3 * scalar_size;
+  for (auto i = _begin; i < _end; ++i, ++_out) {
+    for (auto &coord : *_out) {
+      coord = is_float32() ? read(p, float()) : read(p, double());
+      p += scalar_size;
+    }
+  }
+}
+
+void MappedPointFile::load(Points &_pts, IExecutor *_exec) const {
+  _pts.resize(size());
+  parallel_for(_exec, size(), 1 << 18, [this, &_pts](size_t _b, size_t _e) {
+    copy(_b, _e, _pts.data() + _b);
+  });
+}
+
+std::unique_ptr<Mesh> make_convex_hull(const MappedPointFile &_file,
+                                       const HullOptions &_opts) {
+  if (_opts.m_engine == HullEngine::QuickHull &&
+      _opts.m_cull_directions == 0 && little_endian_host()) {
+    auto mesh = std::make_unique<Mesh>();
+    auto hull_slice = [&_file, &_opts](size_t _begin, size_t _size,
+                                       Mesh &_mesh) {
+      if (_file.is_float32())
+        make_quick_hull(_file.data_float32() + _begin, _size,
+                        _opts.m_trace.get(), _mesh, _opts.m_stats.get());
+      else
+        make_quick_hull(_file.data() + _begin, _size, _opts.m_trace.get(),
+                        _mesh, _opts.m_stats.get());
+    };
+    if (_file.size() <= QuickHull::MAX_POINTS) {
+      hull_slice(0, _file.size(), *mesh);
+      return mesh;
+    }
+    // Quickhull indexes the points with 32 bits: hulls slices of the file
+    // and inserts their vertices in the hull of the previous ones.
+    QuickHull hull;
+    Mesh slice_hull;
+    for (size_t b = 0; b < _file.size(); b += QuickHull::MAX_POINTS) {
+      hull_slice(b, std::min(_file.size() - b, QuickHull::MAX_POINTS),
+                 slice_hull);
+      hull.insert(slice_hull.m_pts.data(), slice_hull.size());
+      if (_opts.m_stats)
+        _opts.m_stats->m_quickhull_dropped += hull.dropped();
+    }
+    hull.to_mesh(*mesh);
+    return mesh;
+  }
+  Points pts;
+  _file.load(pts, _opts.m_executor.get());
+  return make_convex_hull(pts, _opts);
+}
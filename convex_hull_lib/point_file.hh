@@ -0,0 +1,58 @@
+#pragma once
+
+#include "file_mapping.hh"
+#include "point_hull.hh"
+
+#include <cstdint>
+#include <string>
+
+// Binary point file, little endian on every host:
+//   header of 24 bytes:
+//     char     magic[4]     "CHPT"
+//     uint32_t version      1
+//     uint32_t scalar_size  8 for float64 or 4 for float32
+//     uint32_t reserved     0
+//     uint64_t point_nmbr
+//   point_nmbr packed triples x, y, z of the given scalar type.
+struct PointFileHeader {
+  char m_magic[4] = {'C', 'H', 'P', 'T'};
+  uint32_t m_version = 1;
+  uint32_t m_scalar_size = sizeof(double);
+  uint32_t m_reserved = 0;
+  uint64_t m_point_nmbr = 0;
+};
+
+void save_point_file(const std::string &_flnm, const Geo::VectorD3 *_pts,
+                     size_t _size, bool _float32 = false);
+
+// Read only memory mapping of a point file. A big endian host cannot use
+// the points in place: it gets them byte swapped by copy().
+class MappedPointFile {
+public:
+  explicit MappedPointFile(const std::string &_flnm);
+
+  size_t size() const { return m_header.m_point_nmbr; }
+  bool is_float32() const { return m_header.m_scalar_size == sizeof(float); }
+  // The points in place for a float64 file, null for a float32 one or on a
+  // big endian host.
+  const Geo::VectorD3 *data() const;
+  // The points in place for a float32 file, null for a float64 one or on a
+  // big endian host.
+  const Geo::VectorF3 *data_float32() const;
+  // Copies the points [_begin, _end) in _out converting them to float64.
+  void copy(size_t _begin, size_t _end, Geo::VectorD3 *_out) const;
+  // Copies all the points, in parallel if _exec is given.
+  void load(Points &_pts, IExecutor *_exec = nullptr) const;
+
+private:
+  FileMapping m_map;
+  // In the byte order of the host.
+  PointFileHeader m_header;
+  const char *m_points = nullptr;
+};
+
+// Quickhulls the file in place, in either precision, in slices of at most
+// 2^32 - 1 points. Otherwise, or on a big endian host, the points are
+// copied once in memory, where the other options can reorder them.
+std::unique_ptr<Mesh> make_convex_hull(const MappedPointFile &_file,
+                                       const HullOptions &_opts = HullOptions());
@@ -1,424 +1,976 @@
 #include "point_hull.hh"
+#include "hull_classifier.hh"
+#include "interior_cull.hh"
+#include "mesh_writer.hh"
+#include "point_morton.hh"
+#include "point_soa.hh"
+#include "predicates.hh"
+#include "quick_hull.hh"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <fstream>
+#include <optional>
 #include <set>
 #include <string>
 
-static const size_t INVALID = std::numeric_limits<size_t>::max();
+static const VertIdx INVALID = std::numeric_limits<VertIdx>::max();
 
-struct Evaluator {
-  Evaluator(const Geo::VectorD3 &_mid_pt0, const Geo::VectorD3 &_mid_pt1,
-            size_t _split_coord, double _split_val)
-      : m_split_coord(_split_coord), m_split_val(_split_val) {
-    m_center = get_center_point(_mid_pt0, _mid_pt1);
-  }
-
-  double evaluate(const Geo::VectorD3 &_pt0, const Geo::VectorD3 &_pt1,
-                  Geo::VectorD3 &_pt_pl) {
-    _pt_pl = get_center_point(_pt0, _pt1);
-    return Geo::length_square(_pt_pl - m_center);
-  }
+namespace {
 
-  double evaluate_angle(const Geo::VectorD3 &_pt0, const Geo::VectorD3 &_pt1,
-                        const Geo::VectorD3 &_ref, Geo::VectorD3 &_pt_pl) {
-    _pt_pl = get_center_point(_pt0, _pt1);
-    auto pt_to_ref = _pt_pl - _ref;
-    auto cen_to_ref = m_center - _ref;
-    auto sin_a = (pt_to_ref % cen_to_ref)[m_split_coord];
-    if (sin_a < 0) // Check the rotation is jot negative.
-      return -1;
-    auto cos_a = pt_to_ref * cen_to_ref;
-    return atan2(sin_a, cos_a);
+// Adds the time from its construction to its destruction to a counter of
+// the stats, if there are stats.
+class PhaseTimer {
+public:
+  PhaseTimer(HullStats *_stats, std::atomic<uint64_t> HullStats::*_counter)
+      : m_stats(_stats), m_counter(_counter) {
+    if (m_stats)
+      m_start = std::chrono::steady_clock::now();
   }
-
-  Geo::VectorD3 get_center_point(const Geo::VectorD3 &_pt0,
-                                 const Geo::VectorD3 &_pt1) {
-    auto center_pt = (_pt1 + _pt0) * .5;
-    center_pt[m_split_coord] = 0;
-    return center_pt;
+  ~PhaseTimer() {
+    if (!m_stats)
+      return;
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_start);
+    (m_stats->*m_counter)
+        .fetch_add(elapsed.count(), std::memory_order_relaxed);
   }
 
-  size_t m_split_coord;
-  double m_split_val;
-  Geo::VectorD3 m_center;
+private:
+  HullStats *m_stats;
+  std::atomic<uint64_t> HullStats::*m_counter;
+  std::chrono::steady_clock::time_point m_start;
 };
 
-static size_t replace_vertex(Mesh *mm, size_t v0, size_t v1, size_t oth,
-                             std::array<size_t, 2> &adj) {
-  const auto &orig = mm->m_vert_conn[v0].m_pt;
-  auto dir = mm->m_vert_conn[v1].m_pt - orig;
-  dir /= Geo::length(dir);
-  auto find_dir = [mm, &orig, &dir](size_t v) {
-    auto res = mm->m_vert_conn[v].m_pt - orig;
-    return res - (res * dir) * dir;
-  };
-  auto adj0 = find_dir(adj[0]);
-  auto adj1 = find_dir(adj[1]);
-  auto oth_v = find_dir(oth);
-  auto angle_ref = fabs(Geo::angle(adj0, adj1));
-  auto angle_0 = fabs(Geo::angle(adj0, oth_v));
-  auto angle_1 = fabs(Geo::angle(adj1, oth_v));
-  size_t disconnect;
-  if (angle_0 > angle_1 && angle_0 > angle_ref) {
-    disconnect = adj[1];
-    adj[1] = oth;
-  } else if (angle_1 > angle_0 && angle_1 > angle_ref) {
-    disconnect = adj[0];
-    adj[0] = oth;
-  } else
-    disconnect = oth;
-  return disconnect;
+void add_stat(HullStats *_stats, std::atomic<uint64_t> HullStats::*_counter,
+              uint64_t _val) {
+  if (_stats)
+    (_stats->*_counter).fetch_add(_val, std::memory_order_relaxed);
 }
 
-using Link = std::array<size_t, 2>;
+} // namespace
 
-static void remove_internal_links(Mesh *m, const std::vector<Link> &new_links) {
-  if (new_links.size() < 2)
-    return;
-  std::vector<Link> links_for_removal;
-  auto link_0 = std::prev(new_links.end());
-  for (auto link_1 = new_links.begin(); link_1 != new_links.end();
-       link_0 = link_1++) {
-    size_t mesh_idx;
-    if ((*link_0)[0] == (*link_1)[0])
-      mesh_idx = 1;
-    else if ((*link_0)[1] == (*link_1)[1])
-      mesh_idx = 0;
-    else
-      throw "Error";
-    size_t v0 = (*link_0)[mesh_idx];
-    size_t v1 = (*link_1)[mesh_idx];
-    std::array<size_t, 2> adj;
-    size_t cmn_verts = 0;
-    for (auto oth0 : m->m_vert_conn[v0].m_adj_idx) {
-      for (auto oth1 : m->m_vert_conn[v1].m_adj_idx) {
-        if (oth0 == oth1) {
-          if (cmn_verts < 2) {
-            adj[cmn_verts++] = oth1;
-            continue;
-          }
-          auto disconnect = replace_vertex(m, v0, v1, oth1, adj);
-          auto remove_link = [&m](std::array<size_t, 2> link) {
-            for (auto i : {0, 1}) {
-              auto &v_links = m->m_vert_conn[link[i]].m_adj_idx;
-              auto new_end =
-                  std::remove(v_links.begin(), v_links.end(), link[1 - i]);
-              v_links.erase(new_end, v_links.end());
-            }
-          };
-          auto add_link =
-              [&links_for_removal](const Link &link) {
-                links_for_removal.push_back(link);
-                if (links_for_removal.back()[0] > links_for_removal.back()[1])
-                  std::swap(links_for_removal.back()[0],
-                            links_for_removal.back()[1]);
-              };
-          add_link({disconnect, v0});
-          add_link({disconnect, v1});
+using Link = std::array<VertIdx, 2>;
+
+// The merge works on the points moved by the perturbation of
+// Geo::orient3d_sos(), where no 4 points are coplanar: every hull of 4
+// points or more is a sphere of triangles and the adjacency list of every
+// vertex goes counterclockwise around it, seen from outside. The splits put
+// the smaller perturbed points in m[0].
+
+// Lower common tangent of m[0] and m[1] projected on the axes _c and
+// (_c + 1) % 3, which is an edge of the merged hull. Every move lowers the
+// line through the link where it crosses the split plane, so the walk
+// ends.
+static Link lower_tangent(const std::array<Mesh *, 2> &m, size_t _c) {
+  Link link;
+  for (size_t i = 0; i < 2; ++i) {
+    link[i] = 0;
+    while (m[i]->flag(link[i], MeshVertex::TO_DEL))
+      ++link[i];
+  }
+  auto t = (_c + 1) % 3;
+  size_t moves = 0;
+  for (size_t i = 0, still = 0; still < 2; i = 1 - i) {
+    ++still;
+    for (bool moved = true; moved;) {
+      moved = false;
+      for (auto v : m[i]->adjacent(link[i])) {
+        if (Geo::orient2d_sos(m[0]->point(link[0]), m[1]->point(link[1]),
+                              m[i]->point(v), _c, t) < 0) {
+          link[i] = v;
+          moved = true;
+          still = 0;
+          break;
         }
       }
+      if (moved && ++moves > m[0]->size() * m[1]->size())
+        throw "Error";
     }
   }
-  if (links_for_removal.size() < 2)
-    return;
-  std::sort(links_for_removal.begin(), links_for_removal.end());
-  auto l0 = links_for_removal.begin();
-  for (auto l1 = std::next(l0); l1 != links_for_removal.end(); l0 = l1++) {
-    if (*l0 != *l1)
-      continue;
-    for (auto i : {0, 1}) {
-      auto &v_links = m->m_vert_conn[(*l1)[i]].m_adj_idx;
-      auto new_end = std::remove(v_links.begin(), v_links.end(), (*l1)[1 - i]);
-      v_links.erase(new_end, v_links.end());
-    }
-  }
+  return link;
 }
 
-Mesh *merge(std::array<Mesh *, 2> &m, size_t split_coord, double split_val) {
-  Link link{};
-  Geo::VectorD3 p_mid_plane;
-  Evaluator ev(m[0]->m_mid_pt, m[1]->m_mid_pt, split_coord, split_val);
-  {
-    auto best_val = ev.evaluate(m[0]->m_vert_conn[link[0]].m_pt,
-                                m[1]->m_vert_conn[link[1]].m_pt, p_mid_plane);
-    bool a_change;
-    do {
-      a_change = false;
-      auto advance = [&best_val, &a_change, &ev, &p_mid_plane](
-                         Mesh *_m0, Mesh *_m1, size_t &_i0, size_t _i1) {
-        for (auto i0_1 : _m0->m_vert_conn[_i0].m_adj_idx) {
-          Geo::VectorD3 p_mid_plane_tmp;
-          auto new_val =
-              ev.evaluate(_m0->m_vert_conn[i0_1].m_pt,
-                          _m1->m_vert_conn[_i1].m_pt, p_mid_plane_tmp);
-          if (new_val > best_val) {
-            best_val = new_val;
-            _i0 = i0_1;
-            p_mid_plane = p_mid_plane_tmp;
-            a_change = true;
-          }
-        }
-      };
-      advance(m[0], m[1], link[0], link[1]);
-      advance(m[1], m[0], link[1], link[0]);
-    } while (a_change);
-  }
-  std::vector<Link> new_links;
-  new_links.push_back(link);
-  Link link_prev{INVALID, INVALID};
-  for (;;) {
-    double big_angle_new = -1;
-    Link link_new = link;
-    Geo::VectorD3 p_mid_plane_new;
-    auto advance = [&p_mid_plane, &big_angle_new, &ev, &p_mid_plane_new](
-                       Mesh *_m0, Mesh *_m1, size_t _i0, size_t _i1,
-                       size_t &_i0_new, size_t &_i1_new, const size_t &_used) {
-      for (auto i0_1 : _m0->m_vert_conn[_i0].m_adj_idx) {
-        if (_used == i0_1)
-          continue;
-        Geo::VectorD3 p_mid_plane_1;
-        auto big_angle_1 = ev.evaluate_angle(_m0->m_vert_conn[i0_1].m_pt,
-                                             _m1->m_vert_conn[_i1].m_pt,
-                                             p_mid_plane, p_mid_plane_1);
-        if (big_angle_1 > big_angle_new) {
-          big_angle_new = big_angle_1;
-          _i0_new = i0_1;
-          _i1_new = _i1;
-          p_mid_plane_new = p_mid_plane_1;
-        }
+// Next link of the band of faces between the hulls: the face of _link and
+// the neighbour of one of its ends that has all the points behind it, but
+// for the vertex _prev it comes from. _prev gets the end that moves.
+// There are about 6 candidates a step and the floating point filter of
+// orient3d() decides almost all of them, with no transcendental function:
+// pseudo-angles of all the candidates computed first cost more than that.
+static Link wrap_step(const std::array<Mesh *, 2> &m, const Link &_link,
+                      Link &_prev) {
+  const auto &pt0 = m[0]->point(_link[0]);
+  const auto &pt1 = m[1]->point(_link[1]);
+  size_t best_mesh = 0;
+  VertIdx best = INVALID;
+  for (size_t i = 0; i < 2; ++i) {
+    for (auto v : m[i]->adjacent(_link[i])) {
+      if (v == _prev[i])
+        continue;
+      if (best == INVALID ||
+          Geo::orient3d_sos(pt0, pt1, m[best_mesh]->point(best),
+                            m[i]->point(v)) > 0) {
+        best_mesh = i;
+        best = v;
       }
-    };
-    advance(m[0], m[1], link[0], link[1], link_new[0], link_new[1],
-            link_prev[0]);
-    advance(m[1], m[0], link[1], link[0], link_new[1], link_new[0],
-            link_prev[1]);
-    if (link == link_new || new_links.front() == link_new)
-      break;
-    for (auto j : {0, 1}) {
-      if (link_new[j] != link[j])
-        link_prev[j] = link[j];
     }
-    link = link_new;
-    new_links.push_back(link);
-    p_mid_plane = p_mid_plane_new;
-  }
-  auto flag_on_boundary = [&new_links, m](bool set_true) {
-    for (const auto &inds : new_links) {
-      m[1]->m_vert_conn[inds[1]].m_boundary =
-          m[0]->m_vert_conn[inds[0]].m_boundary = set_true;
+  }
+  if (best == INVALID)
+    throw "Error";
+  auto next = _link;
+  _prev = {INVALID, INVALID};
+  _prev[best_mesh] = _link[best_mesh];
+  next[best_mesh] = best;
+  return next;
+}
+
+// The band of faces between the two hulls, from the side of each hull.
+struct Band {
+  explicit Band(std::pmr::memory_resource *_res)
+      : m_links(_res), m_adj(_res), m_border(_res), m_hidden(_res),
+        m_runs(_res), m_hide(_res), m_insert(_res) {
+    m_links.reserve(32);
+    m_adj.reserve(128);
+    m_border.reserve(32);
+    m_hidden.reserve(32);
+    m_runs.reserve(32);
+  }
+
+  // New adjacency lists of the vertices of m[_i] on the band and the
+  // hidden vertices next to them, that are not on the band. The links
+  // around a vertex x of m[0] go from the previous vertex p of m[0] on the
+  // band to the next one q, so its list gets, counterclockwise, p, the
+  // vertices of m[1] linked to x in their order, q and then its neighbours
+  // from q to p. The neighbours from p to q are under the band. A vertex of
+  // m[1] sees the band the other way round. The band can pass more than
+  // once by a vertex, when it goes along an edge and back or when the hull
+  // is flat.
+  void border(const std::array<Mesh *, 2> &m, size_t _i);
+
+  // Vertex of a hull on the band and the range of its new adjacency list
+  // in m_adj.
+  struct BorderVertex {
+    Link m_vert;
+    size_t m_beg, m_end;
+  };
+
+  std::pmr::vector<Link> m_links;
+  // (mesh, vertex) entries of the new adjacency lists.
+  std::pmr::vector<Link> m_adj;
+  std::pmr::vector<BorderVertex> m_border;
+  std::pmr::vector<VertIdx> m_hidden;
+
+private:
+  // Consecutive links around the vertex m_vert, from the neighbour m_beg
+  // to m_end.
+  struct Run {
+    VertIdx m_vert, m_beg, m_end;
+    size_t m_first, m_last;
+  };
+  std::pmr::vector<Run> m_runs;
+  std::pmr::vector<uint8_t> m_hide;
+  std::pmr::vector<size_t> m_insert;
+};
+
+void Band::border(const std::array<Mesh *, 2> &m, size_t _i) {
+  auto &mesh = *m[_i];
+  auto n = m_links.size();
+  // The first run starts after a change.
+  size_t start = 0;
+  while (start < n && m_links[start][_i] == m_links[(start + n - 1) % n][_i])
+    ++start;
+  auto link = [this, start, n](size_t _k) -> const Link & {
+    return m_links[(start + _k) % n];
+  };
+  auto add_linked = [this, _i, &link](size_t _first, size_t _last) {
+    for (auto k = _first; k < _last; ++k) {
+      auto j = _i == 0 ? k : _first + _last - 1 - k;
+      m_adj.push_back({VertIdx(1 - _i), link(j)[1 - _i]});
     }
   };
-  flag_on_boundary(true);
-  std::vector<size_t> vertices_to_remove[2];
-  auto dir_centers = m[1]->m_mid_pt - m[0]->m_mid_pt;
-  auto link_0 = new_links.begin();
-  for (auto link_1 = std::next(link_0); link_1 != new_links.end();
-       link_0 = link_1++) {
-    size_t mesh_idx;
-    if ((*link_0)[0] == (*link_1)[0])
-      mesh_idx = 1;
-    else if ((*link_0)[1] == (*link_1)[1])
-      mesh_idx = 0;
+  if (start == n) {
+    // The band goes all around a single vertex.
+    auto x = m_links[0][_i];
+    mesh.set_flag(x, MeshVertex::BOUNDARY, true);
+    m_hidden.insert(m_hidden.end(), mesh.adjacent(x).begin(),
+                    mesh.adjacent(x).end());
+    m_border.push_back({{VertIdx(_i), x}, m_adj.size(), 0});
+    add_linked(0, n);
+    m_border.back().m_end = m_adj.size();
+    return;
+  }
+  m_runs.clear();
+  bool repeated = false;
+  auto prev = link(n - 1)[_i];
+  for (size_t k = 0; k < n;) {
+    auto x = link(k)[_i];
+    auto k_end = k + 1;
+    while (k_end < n && link(k_end)[_i] == x)
+      ++k_end;
+    auto next = link(k_end % n)[_i];
+    if (_i == 0)
+      m_runs.push_back({x, prev, next, k, k_end});
     else
-      throw "Error";
-    Mesh *mm = m[mesh_idx];
-    size_t v0 = (*link_0)[mesh_idx];
-    size_t v1 = (*link_1)[mesh_idx];
-    std::array<size_t, 2> adj;
-    size_t cmn_verts = 0;
-    for (auto oth0 : mm->m_vert_conn[v0].m_adj_idx) {
-      for (auto oth1 : mm->m_vert_conn[v1].m_adj_idx) {
-        if (oth0 == oth1) {
-          if (cmn_verts < 2)
-            adj[cmn_verts++] = oth1;
-          else
-            replace_vertex(mm, v0, v1, oth1, adj);
-        }
+      m_runs.push_back({x, next, prev, k, k_end});
+    repeated |= mesh.flag(x, MeshVertex::BOUNDARY);
+    mesh.set_flag(x, MeshVertex::BOUNDARY, true);
+    prev = x;
+    k = k_end;
+  }
+  if (repeated) {
+    std::sort(m_runs.begin(), m_runs.end(), [](const Run &_a, const Run &_b) {
+      return _a.m_vert < _b.m_vert ||
+             (_a.m_vert == _b.m_vert && _a.m_first < _b.m_first);
+    });
+  }
+  const size_t NONE = std::numeric_limits<size_t>::max();
+  for (size_t r = 0; r < m_runs.size();) {
+    auto x = m_runs[r].m_vert;
+    auto r_end = r + 1;
+    while (r_end < m_runs.size() && m_runs[r_end].m_vert == x)
+      ++r_end;
+    auto adj = mesh.adjacent(x);
+    auto adj_nmbr = adj.size();
+    auto position = [&adj](VertIdx _w) {
+      auto pos = size_t(std::find(adj.begin(), adj.end(), _w) - adj.begin());
+      if (pos == adj.size())
+        throw "Error";
+      return pos;
+    };
+    m_border.push_back({{VertIdx(_i), x}, m_adj.size(), 0});
+    if (r_end == r + 1) {
+      // The usual case, a single run: the list starts at its beginning.
+      const auto &run = m_runs[r];
+      auto pos_beg = position(run.m_beg), pos_end = position(run.m_end);
+      m_adj.push_back({VertIdx(_i), run.m_beg});
+      add_linked(run.m_first, run.m_last);
+      for (auto j = pos_end; j != pos_beg; j = (j + 1) % adj_nmbr)
+        m_adj.push_back({VertIdx(_i), adj.begin()[j]});
+      for (auto j = (pos_beg + 1) % adj_nmbr; j != pos_end;
+           j = (j + 1) % adj_nmbr) {
+        if (!mesh.flag(adj.begin()[j], MeshVertex::BOUNDARY))
+          m_hidden.push_back(adj.begin()[j]);
       }
+      m_border.back().m_end = m_adj.size();
+      r = r_end;
+      continue;
     }
-    if (cmn_verts == 2) {
-      auto dir_edge = mm->m_vert_conn[v1].m_pt - mm->m_vert_conn[v0].m_pt;
-      double vals[2];
-      for (size_t j = 0; j < 2; ++j) {
-        auto dir_inside =
-            mm->m_vert_conn[adj[j]].m_pt - mm->m_vert_conn[v0].m_pt;
-        dir_inside -=
-            ((dir_inside * dir_edge) / Geo::length_square(dir_edge)) * dir_edge;
-        vals[j] = dir_inside * dir_centers;
-        if (mesh_idx == 1)
-          vals[j] *= -1;
-      }
-      size_t vertex_to_remove = vals[0] > vals[1] ? adj[0] : adj[1];
-      vertices_to_remove[mesh_idx].push_back(vertex_to_remove);
+    m_hide.assign(adj_nmbr, 0);
+    m_insert.assign(adj_nmbr, NONE);
+    for (auto k = r; k < r_end; ++k) {
+      const auto &run = m_runs[k];
+      auto pos_beg = position(run.m_beg), pos_end = position(run.m_end);
+      if (m_insert[pos_beg] != NONE)
+        throw "Error";
+      for (auto j = (pos_beg + 1) % adj_nmbr; j != pos_end;
+           j = (j + 1) % adj_nmbr)
+        m_hide[j] = 1;
+      m_insert[pos_beg] = k;
     }
-  }
-  for (size_t i = 0; i < 2; ++i) {
-    auto mm = m[i];
-    for (size_t j = 0; j < vertices_to_remove[i].size(); ++j) {
-      auto v = vertices_to_remove[i][j];
-      if (mm->m_vert_conn[v].m_to_del || mm->m_vert_conn[v].m_boundary)
+    for (size_t j = 0; j < adj_nmbr; ++j) {
+      auto w = adj.begin()[j];
+      if (m_hide[j]) {
+        if (!mesh.flag(w, MeshVertex::BOUNDARY))
+          m_hidden.push_back(w);
         continue;
-      for (auto v1 : mm->m_vert_conn[v].m_adj_idx) {
-        if (mm->m_vert_conn[v1].m_to_del)
-          continue;
-        if (!mm->m_vert_conn[v1].m_boundary)
-          vertices_to_remove[i].push_back(v1);
-        else {
-          auto it = std::find(mm->m_vert_conn[v1].m_adj_idx.begin(),
-                              mm->m_vert_conn[v1].m_adj_idx.end(), v);
-          if (it != mm->m_vert_conn[v1].m_adj_idx.end())
-            mm->m_vert_conn[v1].m_adj_idx.erase(it);
-        }
       }
-      mm->m_vert_conn[v].m_adj_idx.clear();
-      mm->m_vert_conn[v].m_to_del = true;
+      m_adj.push_back({VertIdx(_i), w});
+      if (m_insert[j] != NONE)
+        add_linked(m_runs[m_insert[j]].m_first, m_runs[m_insert[j]].m_last);
     }
+    m_border.back().m_end = m_adj.size();
+    r = r_end;
   }
-  flag_on_boundary(false);
-  // Add m[1] to m[0]. Must shift indices
-  auto shif_index = m[0]->m_vert_conn.size();
-  for (auto &ele : m[1]->m_vert_conn) {
-    for (auto &adj : ele.m_adj_idx)
-      adj += shif_index;
+}
+
+// Deletes the vertices reached from _stack without crossing the ones
+// flagged BOUNDARY.
+static void remove_hidden(Mesh &_mesh, std::pmr::vector<VertIdx> &_stack,
+                          HullStats *_stats) {
+  while (!_stack.empty()) {
+    auto v = _stack.back();
+    _stack.pop_back();
+    if (_mesh.flag(v, MeshVertex::TO_DEL) ||
+        _mesh.flag(v, MeshVertex::BOUNDARY))
+      continue;
+    for (auto w : _mesh.adjacent(v)) {
+      if (!_mesh.flag(w, MeshVertex::TO_DEL) &&
+          !_mesh.flag(w, MeshVertex::BOUNDARY))
+        _stack.push_back(w);
+    }
+    _mesh.clear_adjacent(v);
+    _mesh.set_flag(v, MeshVertex::TO_DEL, true);
+    ++_mesh.m_dead_nmbr;
+    _mesh.m_adj_garbage += _mesh.m_verts[v].m_adj_cap;
+    add_stat(_stats, &HullStats::m_removed_vertices, 1);
   }
-  m[0]->m_box += m[1]->m_box;
-  m[0]->m_mid_pt =
-      m[0]->m_mid_pt * static_cast<double>(m[0]->m_vert_conn.size()) +
-      m[1]->m_mid_pt * static_cast<double>(m[1]->m_vert_conn.size());
-  m[0]->m_vert_conn.insert(m[0]->m_vert_conn.end(), m[1]->m_vert_conn.begin(),
-                           m[1]->m_vert_conn.end());
-  m[0]->m_mid_pt /= static_cast<double>(m[0]->m_vert_conn.size());
-  for (auto &new_link : new_links) {
-    new_link[1] += shif_index;
-    m[0]->m_vert_conn[new_link[0]].m_adj_idx.push_back(new_link[1]);
-    m[0]->m_vert_conn[new_link[1]].m_adj_idx.push_back(new_link[0]);
-  }
-  // Add the new faces to m[0];
-  delete m[1];
-  remove_internal_links(m[0], new_links);
-  m[0]->compact();
-  save_mesh(m[0]);
-  return m[0];
 }
 
-Mesh *make_convex_hull(Points::iterator _begin, Points::iterator _end) {
-  auto size = _end - _begin;
-  if (size <= 3) {
-    auto m = new Mesh;
-    for (auto i = 0; i < size; ++i) {
-      auto &el = m->m_vert_conn.emplace_back();
-      el.m_pt = *_begin++;
-      m->m_box += el.m_pt;
-      m->m_mid_pt += el.m_pt;
-      for (auto j = size; j-- > 0;) {
-        if (j != i)
-          el.m_adj_idx.push_back(j);
+// Merges m[1] into m[0]. The band of faces between the hulls is wrapped
+// from a common tangent; the parts of the hulls under it go and the
+// vertices on its borders get their new adjacency in order.
+static void merge(std::array<Mesh *, 2> &m, size_t _split_coord,
+                  IHullTrace *_trace, HullStats *_stats) {
+  PhaseTimer merge_timer(_stats, &HullStats::m_merge_ns);
+  add_stat(_stats, &HullStats::m_merges, 1);
+  // The deleted vertices of the previous merges are still there: the
+  // weights of the mid points count only the live ones.
+  VertIdx live_nmbr[2];
+  for (auto i : {0, 1})
+    live_nmbr[i] = static_cast<VertIdx>(m[i]->size()) - m[i]->m_dead_nmbr;
+  std::pmr::vector<VertIdx> ind_map(m[0]->m_adj.get_allocator());
+  m[0]->m_box += m[1]->m_box;
+  m[0]->m_mid_pt = m[0]->m_mid_pt * static_cast<double>(live_nmbr[0]) +
+                   m[1]->m_mid_pt * static_cast<double>(live_nmbr[1]);
+  m[0]->m_mid_pt /= static_cast<double>(live_nmbr[0] + live_nmbr[1]);
+  if (live_nmbr[0] + live_nmbr[1] <= 3) {
+    // No band: the points are all joined, like in a leaf.
+    m[0]->append(*m[1], ind_map);
+    for (VertIdx v = 0; v < m[0]->size(); ++v) {
+      if (m[0]->flag(v, MeshVertex::TO_DEL))
+        continue;
+      m[0]->clear_adjacent(v);
+      for (VertIdx w = 0; w < m[0]->size(); ++w) {
+        if (w != v && !m[0]->flag(w, MeshVertex::TO_DEL))
+          m[0]->add_adjacent(v, w);
       }
     }
-    m->m_mid_pt /= static_cast<double>(size);
-    save_mesh(m);
-    return m;
+  } else {
+    Band band(m[0]->m_adj.get_allocator().resource());
+    band.m_links.push_back(lower_tangent(m, _split_coord));
+    Link prev{INVALID, INVALID};
+    for (;;) {
+      add_stat(_stats, &HullStats::m_wrap_steps, 1);
+      auto link = wrap_step(m, band.m_links.back(), prev);
+      if (link == band.m_links.front())
+        break;
+      // Every link is an edge of the merged hull: a longer walk goes round
+      // in circles.
+      if (band.m_links.size() > m[0]->m_adj.size() + m[1]->m_adj.size())
+        throw "Error";
+      band.m_links.push_back(link);
+    }
+    PhaseTimer timer(_stats, &HullStats::m_remove_links_ns);
+    for (size_t i = 0; i < 2; ++i) {
+      band.border(m, i);
+      remove_hidden(*m[i], band.m_hidden, _stats);
+    }
+    m[0]->append(*m[1], ind_map);
+    auto new_idx = [&ind_map](const Link &_vert) {
+      return _vert[0] == 0 ? _vert[1] : ind_map[_vert[1]];
+    };
+    for (const auto &border : band.m_border) {
+      auto v = new_idx(border.m_vert);
+      m[0]->clear_adjacent(v);
+      for (auto k = border.m_beg; k < border.m_end; ++k)
+        m[0]->add_adjacent(v, new_idx(band.m_adj[k]));
+      m[0]->set_flag(v, MeshVertex::BOUNDARY, false);
+    }
+  }
+  // append() leaves out the garbage of m[1]. The one of m[0] is reclaimed
+  // when it is more than the half of the vertices or of the adjacency
+  // array. The traced meshes are always compact.
+  if (2 * m[0]->m_dead_nmbr > m[0]->size() ||
+      2 * m[0]->m_adj_garbage > m[0]->m_adj.size() || _trace) {
+    PhaseTimer timer(_stats, &HullStats::m_compact_ns);
+    m[0]->compact();
+  }
+  if (_trace)
+    _trace->report(*m[0]);
+}
+
+namespace {
+
+// Counts the bytes taken from the default resource.
+class CountingResource : public std::pmr::memory_resource {
+public:
+  explicit CountingResource(std::atomic<uint64_t> &_bytes) : m_bytes(_bytes) {}
+
+private:
+  void *do_allocate(size_t _bytes, size_t _align) override {
+    m_bytes.fetch_add(_bytes, std::memory_order_relaxed);
+    return std::pmr::get_default_resource()->allocate(_bytes, _align);
   }
-  Geo::Range<3> box;
-  for (auto it = _begin; it != _end; ++it) {
-    box += *it;
+  void do_deallocate(void *_ptr, size_t _bytes, size_t _align) override {
+    std::pmr::get_default_resource()->deallocate(_ptr, _bytes, _align);
   }
+  bool do_is_equal(const memory_resource &_oth) const noexcept override {
+    return this == &_oth;
+  }
+
+  std::atomic<uint64_t> &m_bytes;
+};
+
+// Memory of the intermediate meshes of one hull computation. Each task that
+// can run on its own thread takes its own pool, so the pools need no lock.
+// All of them are released at once when the computation ends.
+class HullArena {
+public:
+  explicit HullArena(HullStats *_stats) {
+    if (_stats)
+      m_counter.emplace(_stats->m_allocated_bytes);
+  }
+
+  std::pmr::memory_resource *new_pool() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_counter)
+      return &m_pools.emplace_back(&*m_counter);
+    return &m_pools.emplace_back();
+  }
+
+private:
+  std::mutex m_mtx;
+  // Declared before the pools, that release their memory to it.
+  std::optional<CountingResource> m_counter;
+  std::deque<std::pmr::unsynchronized_pool_resource> m_pools;
+};
+
+} // namespace
+
+// The points of the recursion at the level _depth: a PointsSoA is split
+// into its buffer _depth % 2, a PointsMorton in place.
+static Geo::VectorD3 level_point(const PointsSoA &_pts, size_t _depth,
+                                 size_t _i) {
+  return _pts.point(_depth % 2, _i);
+}
+
+static const Geo::VectorD3 &level_point(const PointsMorton &_pts, size_t,
+                                        size_t _i) {
+  return _pts.point(_i);
+}
+
+// Splits the points [_begin, _end) of the level _depth with a plane
+// orthogonal to the axis _coord. Returns the first point of the second
+// part, that is _begin or _end if the points are all equal. PointsSoA
+// splits at the median of the longest side of the box.
+static size_t split_points(PointsSoA &_pts, size_t _depth, size_t _begin,
+                           size_t _end, size_t &_coord) {
+  auto buf = _depth % 2;
+  auto box = _pts.box(buf, _begin, _end);
   auto v = box[1] - box[0];
-  size_t split_coord = 0;
+  _coord = 0;
   double len = 0;
   for (size_t i = 0; i < 3; ++i) {
     auto len_i = std::fabs(v[i]);
     if (len_i > len) {
       len = len_i;
-      split_coord = i;
+      _coord = i;
     }
   }
-  std::nth_element(
-      _begin, _begin + size / 2, _end,
-      [split_coord](const Geo::VectorD3 &_a, const Geo::VectorD3 &_b) {
-        return _a[split_coord] < _b[split_coord];
-      });
-  auto mid_iter = _begin + (_end - _begin) / 2;
-  auto split_val =
-      ((*mid_iter)[split_coord] + (*std::prev(mid_iter))[split_coord]) / 2.;
+  return _pts.split(buf, _begin, _end, _coord);
+}
+
+static size_t split_points(PointsMorton &_pts, size_t, size_t _begin,
+                           size_t _end, size_t &_coord) {
+  return _pts.split(_begin, _end, _coord);
+}
+
+// Hull of at most 3 points [_begin, _end) of the level _depth of _pts: all
+// of them joined, but for the repeated ones.
+template <class PointsT>
+static Mesh make_leaf(const PointsT &_pts, size_t _begin, size_t _end,
+                      const HullOptions &_opts, std::pmr::memory_resource *_res,
+                      size_t _depth) {
+  auto stats = _opts.m_stats.get();
+  if (stats) {
+    auto depth = stats->m_max_depth.load(std::memory_order_relaxed);
+    while (depth < _depth && !stats->m_max_depth.compare_exchange_weak(
+                                 depth, _depth, std::memory_order_relaxed))
+      ;
+  }
+  Geo::VectorD3 pts[3];
+  size_t size = 0;
+  for (auto i = _begin; i < _end; ++i) {
+    pts[size] = level_point(_pts, _depth, i);
+    if (std::find(pts, pts + size, pts[size]) == pts + size)
+      ++size;
+  }
+  Mesh m(_res);
+  m.m_pts.reserve(size);
+  m.m_verts.reserve(size);
+  m.m_adj.reserve(size * size);
+  for (size_t i = 0; i < size; ++i) {
+    auto v = m.add_vertex(pts[i], VertIdx(size));
+    m.m_box += m.point(v);
+    m.m_mid_pt += m.point(v);
+    for (auto j = size; j-- > 0;) {
+      if (j != i)
+        m.add_adjacent(v, VertIdx(j));
+    }
+  }
+  m.m_mid_pt /= static_cast<double>(size);
+  if (_opts.m_trace)
+    _opts.m_trace->report(m);
+  return m;
+}
+
+// Hull of the points [_begin, _end) of the level _depth of _pts.
+template <class PointsT>
+static Mesh make_convex_hull(PointsT &_pts, size_t _begin, size_t _end,
+                             const HullOptions &_opts, HullArena &_arena,
+                             std::pmr::memory_resource *_res, size_t _depth) {
+  auto stats = _opts.m_stats.get();
+  auto size = _end - _begin;
+  if (size <= 3)
+    return make_leaf(_pts, _begin, _end, _opts, _res, _depth);
+  size_t mid, split_coord;
+  {
+    PhaseTimer timer(stats, &HullStats::m_nth_element_ns);
+    mid = split_points(_pts, _depth, _begin, _end, split_coord);
+  }
+  // The points are all equal.
+  if (mid == _begin || mid == _end)
+    return make_leaf(_pts, _begin, _begin + 1, _opts, _res, _depth + 1);
+  std::optional<Mesh> halves[2];
+  if (_opts.m_executor && size_t(size) >= _opts.m_parallel_cutoff) {
+    auto res_1 = _arena.new_pool();
+    _opts.m_executor->fork_join(
+        [&] {
+          halves[0].emplace(make_convex_hull(_pts, _begin, mid, _opts,
+                                             _arena, _res, _depth + 1));
+        },
+        [&] {
+          halves[1].emplace(make_convex_hull(_pts, mid, _end, _opts, _arena,
+                                             res_1, _depth + 1));
+        });
+  } else {
+    halves[0].emplace(
+        make_convex_hull(_pts, _begin, mid, _opts, _arena, _res, _depth + 1));
+    halves[1].emplace(
+        make_convex_hull(_pts, mid, _end, _opts, _arena, _res, _depth + 1));
+  }
+  std::array<Mesh *, 2> m{&*halves[0], &*halves[1]};
+  merge(m, split_coord, _opts.m_trace.get(), stats);
+  return std::move(*halves[0]);
+}
+
+// Hull of all the points of _pts under the perturbation, with its faces.
+template <class PointsT>
+static std::unique_ptr<Mesh> make_perturbed_hull(PointsT &_pts,
+                                                 const HullOptions &_opts) {
+  HullArena arena(_opts.m_stats.get());
+  auto mesh =
+      make_convex_hull(_pts, 0, _pts.size(), _opts, arena, arena.new_pool(), 0);
+  // The copy moves the result out of the arena.
+  auto result = std::make_unique<Mesh>(mesh);
+  {
+    PhaseTimer timer(_opts.m_stats.get(), &HullStats::m_compact_ns);
+    result->compact();
+  }
+  result->trace_faces();
+  return result;
+}
+
+std::unique_ptr<Mesh> make_convex_hull(Points &_points,
+                                       const HullOptions &_opts) {
+  auto end = _points.end();
+  if (_opts.m_cull_directions > 0) {
+    auto culled = cull_interior_points(
+        _points.begin(), end, _opts.m_cull_directions, _opts.m_executor.get());
+    add_stat(_opts.m_stats.get(), &HullStats::m_culled_points, culled);
+    end -= culled;
+  }
+  if (_opts.m_engine == HullEngine::QuickHull) {
+    auto mesh = std::make_unique<Mesh>();
+    make_quick_hull(_points.data(), end - _points.begin(),
+                    _opts.m_trace.get(), *mesh, _opts.m_stats.get());
+    return mesh;
+  }
+  auto size = size_t(end - _points.begin());
+  std::unique_ptr<Mesh> result;
+  if (_opts.m_presort) {
+    std::optional<PointsMorton> sorted;
+    {
+      PhaseTimer timer(_opts.m_stats.get(), &HullStats::m_nth_element_ns);
+      sorted.emplace(_points.data(), size, _opts.m_executor.get());
+    }
+    result = make_perturbed_hull(*sorted, _opts);
+  } else {
+    PointsSoA soa(_points.data(), size, _opts.m_executor.get());
+    result = make_perturbed_hull(soa, _opts);
+  }
+  // The perturbation moves out the points on the faces and on the edges of
+  // the hull: the hull of the corners alone has none of them. Flat points
+  // have no corners.
+  auto corners = find_corners(*result);
+  if (corners.empty()) {
+    auto flat = std::make_unique<Mesh>();
+    make_quick_hull(result->m_pts.data(), result->size(), nullptr, *flat,
+                    _opts.m_stats.get());
+    return flat;
+  }
+  if (corners.size() < result->size()) {
+    Points pts(corners.size());
+    for (size_t i = 0; i < corners.size(); ++i)
+      pts[i] = result->point(corners[i]);
+    PointsSoA soa(pts.data(), pts.size(), _opts.m_executor.get());
+    result = make_perturbed_hull(soa, _opts);
+  }
+  return result;
+}
+
+std::unique_ptr<Mesh> make_convex_hull(const PointsF &_points,
+                                       const HullOptions &_opts) {
+  if (_opts.m_engine == HullEngine::QuickHull && _opts.m_cull_directions == 0) {
+    auto mesh = std::make_unique<Mesh>();
+    make_quick_hull(_points.data(), _points.size(), _opts.m_trace.get(), *mesh,
+                    _opts.m_stats.get());
+    return mesh;
+  }
+  Points pts(_points.size());
+  parallel_for(_opts.m_executor.get(), pts.size(), 1 << 18,
+               [&pts, &_points](size_t _b, size_t _e) {
+                 for (auto i = _b; i < _e; ++i)
+                   pts[i] = {_points[i][0], _points[i][1], _points[i][2]};
+               });
+  return make_convex_hull(pts, _opts);
+}
+
+std::unique_ptr<Mesh> make_convex_hull(IPointSource &_source,
+                                       const HullOptions &_opts) {
+  auto chunk_opts = _opts;
+  chunk_opts.m_engine = HullEngine::QuickHull;
+  chunk_opts.m_trace.reset();
+  Points chunk(
+      std::clamp<size_t>(_opts.m_chunk_size, 1, QuickHull::MAX_POINTS));
+  QuickHull hull;
+  auto mesh = std::make_unique<Mesh>();
+  for (;;) {
+    chunk.resize(chunk.capacity());
+    chunk.resize(_source.read(chunk.data(), chunk.size()));
+    if (chunk.empty())
+      break;
+    auto chunk_hull = make_convex_hull(chunk, chunk_opts);
+    hull.insert(chunk_hull->m_pts.data(), chunk_hull->size());
+    if (_opts.m_stats)
+      _opts.m_stats->m_quickhull_dropped += hull.dropped();
+    if (_opts.m_trace) {
+      hull.to_mesh(*mesh);
+      _opts.m_trace->report(*mesh);
+    }
+  }
+  hull.to_mesh(*mesh);
+  // The chunks that came later can bury the corners of the previous ones
+  // on the faces.
+  keep_corners(*mesh, _opts.m_stats.get());
+  return mesh;
+}
+
+// A warm started hull classifies the points first if they are this many
+// times its vertices.
+static const size_t WARM_CLASSIFY_RATIO = 4;
+
+std::unique_ptr<Mesh> make_convex_hull(const Points &_points, const Mesh &_prev,
+                                       std::vector<uint32_t> &_input_idx,
+                                       const HullOptions &_opts) {
+  if (_points.size() > QuickHull::MAX_POINTS)
+    throw "Error";
+  auto stats = _opts.m_stats.get();
+  auto mesh = std::make_unique<Mesh>();
+  bool valid = !_prev.m_faces.empty() && _input_idx.size() == _prev.size();
+  for (size_t v = 0; v < _input_idx.size() && valid; ++v)
+    valid = _input_idx[v] < _points.size();
+
+  QuickHull hull;
+  bool warm = false;
+  if (valid) {
+    Mesh moved(_prev);
+    for (VertIdx v = 0; v < moved.size(); ++v)
+      moved.m_pts[v] = _points[_input_idx[v]];
+    if (hull.build(moved, _input_idx.data())) {
+      if (hull.convex()) {
+        warm = true;
+        if (stats)
+          ++stats->m_warm_kept;
+      } else if (hull.make_convex()) {
+        warm = true;
+        if (stats)
+          ++stats->m_warm_repaired;
+      }
+    }
+  }
+  if (warm) {
+    // The vertices are on the hull. The ones the repair removed are tested
+    // like the other points: a later flip can leave them slightly outside.
+    // With many more points than vertices, only the ones beyond the faces,
+    // or too close to decide without the exact predicates, are inserted.
+    std::vector<uint32_t> kept_idx;
+    hull.to_mesh(*mesh, &kept_idx);
+    std::vector<uint8_t> inside(_points.size(), 0);
+    if (_points.size() > WARM_CLASSIFY_RATIO * mesh->size()) {
+      HullClassifier classifier(*mesh, -hull.tolerance());
+      classifier.classify(_points.data(), _points.size(), inside.data(),
+                          _opts.m_executor.get());
+    }
+    for (auto idx : kept_idx)
+      inside[idx] = 1;
+    Points rest;
+    std::vector<uint32_t> rest_idx;
+    for (uint32_t i = 0; i < _points.size(); ++i) {
+      if (!inside[i]) {
+        rest.push_back(_points[i]);
+        rest_idx.push_back(i);
+      }
+    }
+    hull.insert(rest.data(), rest.size(), _opts.m_trace.get(),
+                rest_idx.data());
+  } else {
+    if (stats)
+      ++stats->m_warm_rebuilt;
+    if (!hull.build(_points.data(), _points.size(), _opts.m_trace.get())) {
+      make_flat_hull(_points.data(), _points.size(), hull.tolerance(), *mesh);
+      _input_idx.clear();
+      return mesh;
+    }
+  }
+  if (stats)
+    stats->m_quickhull_dropped += hull.dropped();
+  hull.to_mesh(*mesh, &_input_idx);
+  return mesh;
+}
+
+std::unique_ptr<Mesh> make_convex_hull(const std::vector<const Mesh *> &_hulls,
+                                       const HullOptions &_opts) {
+  // The hull of the union is the hull of the vertices. Quickhull is robust
+  // on overlaps and touches only the vertices that end on the hull, most of
+  // them here.
+  auto vert_opts = _opts;
+  vert_opts.m_engine = HullEngine::QuickHull;
+  size_t size = 0;
+  for (auto hull : _hulls)
+    size += hull->size();
+  Points pts;
+  pts.reserve(size);
+  for (auto hull : _hulls)
+    pts.insert(pts.end(), hull->m_pts.begin(), hull->m_pts.end());
+  return make_convex_hull(pts, vert_opts);
+}
 
-  std::array<Mesh *, 2> m{make_convex_hull(_begin, mid_iter),
-                          make_convex_hull(mid_iter, _end)};
-  return merge(m, split_coord, split_val);
+VertIdx Mesh::add_vertex(const Geo::VectorD3 &_pt, VertIdx _adj_cap) {
+  auto v = static_cast<VertIdx>(m_verts.size());
+  m_pts.push_back(_pt);
+  auto &vert = m_verts.emplace_back();
+  vert.m_adj_off = static_cast<VertIdx>(m_adj.size());
+  vert.m_adj_cap = _adj_cap;
+  m_adj.resize(m_adj.size() + _adj_cap);
+  return v;
+}
+
+void Mesh::add_adjacent(VertIdx _v, VertIdx _w) {
+  auto &vert = m_verts[_v];
+  if (vert.m_adj_nmbr == vert.m_adj_cap) {
+    // Moves the list to the end of m_adj with twice the room.
+    auto new_off = static_cast<VertIdx>(m_adj.size());
+    m_adj_garbage += vert.m_adj_cap;
+    vert.m_adj_cap = std::max<VertIdx>(4, 2 * vert.m_adj_cap);
+    m_adj.resize(m_adj.size() + vert.m_adj_cap);
+    std::copy_n(m_adj.begin() + vert.m_adj_off, vert.m_adj_nmbr,
+                m_adj.begin() + new_off);
+    vert.m_adj_off = new_off;
+  }
+  m_adj[vert.m_adj_off + vert.m_adj_nmbr++] = _w;
 }
 
-Mesh *make_convex_hull(Points &_points) {
-  return make_convex_hull(_points.begin(), _points.end());
+void Mesh::remove_adjacent(VertIdx _v, VertIdx _w) {
+  auto adj = adjacent(_v);
+  auto new_end = std::remove(adj.begin(), adj.end(), _w);
+  m_verts[_v].m_adj_nmbr = static_cast<VertIdx>(new_end - adj.begin());
+}
+
+void Mesh::append(const Mesh &_oth, std::pmr::vector<VertIdx> &_ind_map) {
+  auto valid_ind = static_cast<VertIdx>(m_verts.size());
+  _ind_map.resize(_oth.size());
+  for (size_t i = 0; i < _oth.size(); ++i) {
+    if (_oth.m_verts[i].m_flags & MeshVertex::TO_DEL)
+      _ind_map[i] = INVALID;
+    else
+      _ind_map[i] = valid_ind++;
+  }
+  for (VertIdx i = 0; i < _oth.size(); ++i) {
+    if (_ind_map[i] == INVALID)
+      continue;
+    m_pts.push_back(_oth.m_pts[i]);
+    auto &vert = m_verts.emplace_back(_oth.m_verts[i]);
+    vert.m_adj_off = static_cast<VertIdx>(m_adj.size());
+    vert.m_adj_cap = vert.m_adj_nmbr;
+    for (auto idx : _oth.adjacent(i))
+      m_adj.push_back(_ind_map[idx]);
+  }
+  for (auto face : _oth.m_faces) {
+    bool live = true;
+    for (auto &v : face.m_vert) {
+      v = _ind_map[v];
+      live &= v != INVALID;
+    }
+    if (live)
+      m_faces.push_back(face);
+  }
 }
 
 void Mesh::compact() {
-  auto size = m_vert_conn.size();
-  std::vector<size_t> ind_map(size);
-  size_t valid_ind = 0;
-  std::vector<MeshVertex> new_data;
+  auto size = m_verts.size();
+  std::pmr::vector<VertIdx> ind_map(size, m_adj.get_allocator());
+  VertIdx valid_ind = 0;
+  size_t adj_nmbr = 0;
   for (size_t i = 0; i < size; ++i) {
-    if (m_vert_conn[i].m_to_del)
+    if (m_verts[i].m_flags & MeshVertex::TO_DEL)
       ind_map[i] = INVALID;
     else {
-      new_data.emplace_back(m_vert_conn[i]);
       ind_map[i] = valid_ind++;
+      adj_nmbr += m_verts[i].m_adj_nmbr;
     }
   }
-  for (auto &v_conn : new_data) {
-    for (auto &idx : v_conn.m_adj_idx) {
-      idx = ind_map[idx];
-    }
+  decltype(m_pts) new_pts(m_pts.get_allocator());
+  decltype(m_verts) new_verts(m_verts.get_allocator());
+  decltype(m_adj) new_adj(m_adj.get_allocator());
+  new_pts.reserve(valid_ind);
+  new_verts.reserve(valid_ind);
+  new_adj.reserve(adj_nmbr);
+  for (size_t i = 0; i < size; ++i) {
+    if (ind_map[i] == INVALID)
+      continue;
+    new_pts.push_back(m_pts[i]);
+    auto &vert = new_verts.emplace_back(m_verts[i]);
+    vert.m_adj_off = static_cast<VertIdx>(new_adj.size());
+    vert.m_adj_cap = vert.m_adj_nmbr;
+    for (auto idx : adjacent(VertIdx(i)))
+      new_adj.push_back(ind_map[idx]);
   }
-  m_vert_conn = std::move(new_data);
-}
-
-void common_element(const std::vector<size_t> &_a,
-                    const std::vector<size_t> &_b, std::vector<size_t> &_res) {
-  _res.clear();
-  std::set_intersection(_a.begin(), _a.end(), _b.begin(), _b.end(),
-                        std::back_inserter(_res));
+  m_pts = std::move(new_pts);
+  m_verts = std::move(new_verts);
+  m_adj = std::move(new_adj);
+  m_dead_nmbr = 0;
+  m_adj_garbage = 0;
+  auto face_end = std::remove_if(
+      m_faces.begin(), m_faces.end(), [&ind_map](MeshFace &_face) {
+        for (auto &v : _face.m_vert) {
+          v = ind_map[v];
+          if (v == INVALID)
+            return true;
+        }
+        return false;
+      });
+  m_faces.erase(face_end, m_faces.end());
 }
 
 void Mesh::save(const char *_flnm) {
   compact();
-  std::ofstream cc(_flnm);
-  for (auto &v_conn : m_vert_conn) {
-    cc << "v " << v_conn.m_pt[0] << ' ' << v_conn.m_pt[1] << ' '
-       << v_conn.m_pt[2] << std::endl;
-    std::sort(v_conn.m_adj_idx.begin(), v_conn.m_adj_idx.end());
-  }
-  std::array<size_t, 3> ff;
-  std::vector<std::array<size_t, 3>> all_faces;
-  std::vector<size_t> third_verts;
-  for (ff[0] = 0; ff[0] < m_vert_conn.size(); ++ff[0]) {
-    for (auto id : m_vert_conn[ff[0]].m_adj_idx) {
-      if (id <= ff[0])
+  if (m_faces.empty())
+    make_faces();
+  save_mesh(*this, _flnm, mesh_format(_flnm));
+}
+
+void Mesh::make_faces() {
+  m_faces.clear();
+  Geo::VectorD3 center{};
+  size_t solid_nmbr = 0;
+  for (VertIdx v = 0; v < size(); ++v) {
+    if (m_verts[v].m_adj_nmbr >= 3) {
+      center += point(v);
+      ++solid_nmbr;
+    }
+  }
+  if (solid_nmbr < 4)
+    return;
+  center /= double(solid_nmbr);
+
+  std::vector<std::pair<double, VertIdx>> around;
+  for (VertIdx v = 0; v < size(); ++v) {
+    auto axis = point(v) - center;
+    auto u = axis % (std::fabs(axis[0]) < std::fabs(axis[1])
+                         ? Geo::VectorD3{1, 0, 0}
+                         : Geo::VectorD3{0, 1, 0});
+    auto w = axis % u;
+    auto adj = adjacent(v);
+    around.clear();
+    for (auto n : adj) {
+      if (n == INVALID)
         continue;
-      ff[1] = id;
-      common_element(m_vert_conn[ff[0]].m_adj_idx, m_vert_conn[ff[1]].m_adj_idx,
-                     third_verts);
-      for (auto id2 : third_verts) {
-        if (id2 <= ff[1])
-          continue;
-        ff[2] = id2;
-        std::sort(ff.begin(), ff.end());
-        all_faces.push_back(ff);
+      auto d = point(n) - point(v);
+      around.emplace_back(std::atan2(d * w, d * u), n);
+    }
+    std::sort(around.begin(), around.end());
+    auto end = adj.begin();
+    for (size_t i = 0; i < around.size(); ++i) {
+      if (i == 0 || around[i].second != around[i - 1].second)
+        *end++ = around[i].second;
+    }
+    m_verts[v].m_adj_nmbr = static_cast<VertIdx>(end - adj.begin());
+  }
+  trace_faces();
+}
+
+void Mesh::trace_faces() {
+  m_faces.clear();
+  // Slot of _w in the adjacency of _v.
+  auto find_pos = [this](VertIdx _v, VertIdx _w) {
+    auto adj = adjacent(_v);
+    auto it = std::find(adj.begin(), adj.end(), _w);
+    return it == adj.end() ? INVALID : VertIdx(it - m_adj.data());
+  };
+
+  std::vector<bool> done(m_adj.size(), false);
+  std::vector<VertIdx> poly;
+  for (VertIdx v = 0; v < size(); ++v) {
+    for (auto k = m_verts[v].m_adj_off;
+         k < m_verts[v].m_adj_off + m_verts[v].m_adj_nmbr; ++k) {
+      if (done[k])
+        continue;
+      // Follows the polygon on the left of the edge v, m_adj[k]: it leaves
+      // every vertex towards the neighbour that precedes the one it came
+      // from.
+      poly.clear();
+      auto a = v;
+      auto pos = k;
+      while (pos != INVALID && !done[pos]) {
+        done[pos] = true;
+        poly.push_back(a);
+        auto b = m_adj[pos];
+        pos = b == INVALID ? INVALID : find_pos(b, a);
+        if (pos != INVALID)
+          pos = (pos == m_verts[b].m_adj_off ? pos + m_verts[b].m_adj_nmbr
+                                             : pos) - 1;
+        a = b;
+      }
+      if (pos != k || poly.size() < 3)
+        continue;
+      for (size_t i = 1; i + 1 < poly.size(); ++i) {
+        auto &face = m_faces.emplace_back();
+        face.m_vert = {poly[0], poly[i], poly[i + 1]};
+        const auto &p0 = point(poly[0]);
+        face.m_normal = (point(poly[i]) - p0) % (point(poly[i + 1]) - p0);
+        face.m_normal /= Geo::length(face.m_normal);
+        face.m_dist = face.m_normal * p0;
       }
     }
   }
-  std::sort(all_faces.begin(), all_faces.end());
-  auto last = std::unique(all_faces.begin(), all_faces.end());
-  all_faces.erase(last, all_faces.end());
-  for (auto &f : all_faces) {
-    cc << "f " << f[0] + 1 << ' ' << f[1] + 1 << ' ' << f[2] + 1 << std::endl;
+}
+
+namespace {
+
+struct ObjDumpTrace : public IHullTrace {
+  explicit ObjDumpTrace(const std::string &_dir) : m_dir(_dir) {}
+  void report(const Mesh &_mesh) override {
+    auto prefix = std::to_string(m_nn++);
+    while (prefix.size() < 4)
+      prefix = std::string("0") + prefix;
+    auto flnm = m_dir.empty() ? prefix : m_dir + '/' + prefix;
+    Mesh(_mesh).save((flnm + "_mesh.obj").c_str());
   }
+  std::string m_dir;
+  std::atomic<int> m_nn{0};
+};
+
+} // namespace
+
+std::shared_ptr<IHullTrace> IHullTrace::make_obj_dump(const std::string &_dir) {
+  return std::make_shared<ObjDumpTrace>(_dir);
 }
 
-void save_mesh(Mesh *m) {
-  static int nn = 0;
-  auto prefix = std::to_string(nn++);
-  while (prefix.size() < 4)
-    prefix = std::string("0") + prefix;
-  m->save((prefix + "_mesh.obj").c_str());
+void HullTraceCapture::report(const Mesh &_mesh) {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  m_meshes.push_back(_mesh);
 }
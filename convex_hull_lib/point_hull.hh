@@ -1,27 +1,237 @@
 #pragma once
 
+#include "executor.hh"
+#include "point_source.hh"
 #include "range.hh"
 #include "vector.hh"
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <string>
 #include <vector>
 
+using VertIdx = uint32_t;
+
+// Position of the adjacency list of a vertex inside Mesh::m_adj.
 struct MeshVertex {
-  Geo::VectorD3 m_pt;
-  std::vector<size_t> m_adj_idx;
-  bool m_boundary = false;
-  bool m_to_del = false;
+  enum Flag : uint8_t { BOUNDARY = 1, TO_DEL = 2 };
+  VertIdx m_adj_off = 0;
+  VertIdx m_adj_nmbr = 0;
+  VertIdx m_adj_cap = 0;
+  uint8_t m_flags = 0;
+};
+
+// Triangle of a hull, counterclockwise seen from outside. The plane is
+// m_normal * x == m_dist with m_normal of unit length.
+struct MeshFace {
+  std::array<VertIdx, 3> m_vert;
+  Geo::VectorD3 m_normal;
+  double m_dist;
 };
 
+template <class IdxT> struct IndexRange {
+  IdxT *m_begin;
+  IdxT *m_end;
+  IdxT *begin() const { return m_begin; }
+  IdxT *end() const { return m_end; }
+  size_t size() const { return m_end - m_begin; }
+  bool empty() const { return m_begin == m_end; }
+};
+
+// Vertices of a hull and their adjacency. All the adjacency lists are slots
+// of the single array m_adj: a list that outgrows its slot moves to the end
+// of the array and compact() squeezes out the holes left behind.
+// The arrays come from the given memory resource; a copy always uses the
+// default one.
+// The vertices flagged TO_DEL stay in the arrays until compact().
+// The faces of a finished hull are in m_faces. The hull engines fill them;
+// make_faces() rebuilds them from the adjacency.
 struct Mesh {
+  Mesh() = default;
+  explicit Mesh(std::pmr::memory_resource *_res)
+      : m_pts(_res), m_verts(_res), m_adj(_res), m_faces(_res) {}
+
   Geo::Range<3> m_box;
   Geo::VectorD3 m_mid_pt{};
-  std::vector<MeshVertex> m_vert_conn;
+  std::pmr::vector<Geo::VectorD3> m_pts;
+  std::pmr::vector<MeshVertex> m_verts;
+  std::pmr::vector<VertIdx> m_adj;
+  std::pmr::vector<MeshFace> m_faces;
+  // Vertices flagged TO_DEL and slots of m_adj left by the lists that moved
+  // or were deleted.
+  VertIdx m_dead_nmbr = 0;
+  VertIdx m_adj_garbage = 0;
+
+  size_t size() const { return m_verts.size(); }
+  const Geo::VectorD3 &point(VertIdx _v) const { return m_pts[_v]; }
+
+  IndexRange<const VertIdx> adjacent(VertIdx _v) const {
+    auto beg = m_adj.data() + m_verts[_v].m_adj_off;
+    return {beg, beg + m_verts[_v].m_adj_nmbr};
+  }
+  IndexRange<VertIdx> adjacent(VertIdx _v) {
+    auto beg = m_adj.data() + m_verts[_v].m_adj_off;
+    return {beg, beg + m_verts[_v].m_adj_nmbr};
+  }
+
+  bool flag(VertIdx _v, MeshVertex::Flag _flag) const {
+    return (m_verts[_v].m_flags & _flag) != 0;
+  }
+  void set_flag(VertIdx _v, MeshVertex::Flag _flag, bool _on) {
+    if (_on)
+      m_verts[_v].m_flags |= _flag;
+    else
+      m_verts[_v].m_flags &= ~_flag;
+  }
+
+  // Adds an isolated vertex with room for _adj_cap adjacent vertices.
+  VertIdx add_vertex(const Geo::VectorD3 &_pt, VertIdx _adj_cap = 0);
+  void add_adjacent(VertIdx _v, VertIdx _w);
+  // Removes every occurrence of _w from the adjacency of _v.
+  void remove_adjacent(VertIdx _v, VertIdx _w);
+  void clear_adjacent(VertIdx _v) { m_verts[_v].m_adj_nmbr = 0; }
+  // Appends the vertices of _oth but the ones flagged TO_DEL. _ind_map gets
+  // the new index of every vertex of _oth, the largest VertIdx for the
+  // deleted ones.
+  void append(const Mesh &_oth, std::pmr::vector<VertIdx> &_ind_map);
+
+  // Compacts and writes the mesh, in the format of the file extension:
+  // .obj, .ply or .stl.
   void save(const char* _flnm);
   void compact();
+  // Sorts the neighbours of every vertex counterclockwise around it, seen
+  // from outside, and splits every polygon they bound in a fan of
+  // triangles. Flat meshes get no faces.
+  void make_faces();
+  // The faces of make_faces() when the neighbours are already sorted.
+  void trace_faces();
+};
+
+// Receives the intermediate meshes of the hull computation: every leaf and
+// the result of every merge, or the hull after every added quickhull
+// vertex. Reports can come from several threads at once.
+struct IHullTrace {
+  virtual ~IHullTrace() = default;
+  virtual void report(const Mesh &_mesh) = 0;
+
+  // Saves every reported mesh as _dir/NNNN_mesh.obj.
+  static std::shared_ptr<IHullTrace> make_obj_dump(const std::string &_dir);
 };
 
-void save_mesh(Mesh *m);
+// Keeps a copy of every reported mesh.
+struct HullTraceCapture : public IHullTrace {
+  void report(const Mesh &_mesh) override;
+  std::vector<Mesh> m_meshes;
+
+private:
+  std::mutex m_mtx;
+};
 
 using Points = std::vector<Geo::VectorD3>;
+using PointsF = std::vector<Geo::VectorF3>;
+
+// Counters of the divide and conquer engine, of the quickhull and of the
+// warm started hull, added to by every computation that gets them. The times
+// are in nanoseconds, summed over the threads; the merge time includes the
+// removal of the hidden vertices and compact. The bytes are the ones the
+// arena of the intermediate meshes takes from the heap.
+struct HullStats {
+  // Depth of the deepest leaf, the whole point set is depth 0.
+  std::atomic<uint64_t> m_max_depth{0};
+  std::atomic<uint64_t> m_merges{0};
+  // Steps of the gift wrapping loop of the merges.
+  std::atomic<uint64_t> m_wrap_steps{0};
+  // Vertices removed by the flood fill of the merges.
+  std::atomic<uint64_t> m_removed_vertices{0};
+  // Points dropped by the interior point culling before the hull.
+  std::atomic<uint64_t> m_culled_points{0};
+  // Split of the points, the presort included.
+  std::atomic<uint64_t> m_nth_element_ns{0};
+  std::atomic<uint64_t> m_merge_ns{0};
+  // Rewrite of the adjacency on the band and removal of the hidden vertices.
+  std::atomic<uint64_t> m_remove_links_ns{0};
+  std::atomic<uint64_t> m_compact_ns{0};
+  std::atomic<uint64_t> m_allocated_bytes{0};
+  // Warm started hulls that kept the faces of the previous one, that
+  // repaired them and that started from scratch.
+  std::atomic<uint64_t> m_warm_kept{0};
+  std::atomic<uint64_t> m_warm_repaired{0};
+  std::atomic<uint64_t> m_warm_rebuilt{0};
+  // Outside points that the quickhull could not add, see
+  // QuickHull::dropped(). They can be left outside the result.
+  std::atomic<uint64_t> m_quickhull_dropped{0};
+};
+
+enum class HullEngine {
+  // Recursive split of the points and merge of the two hulls.
+  DivideAndConquer,
+  // Adds the farthest outside point to the hull one at a time. Fast when the
+  // hull has few vertices compared to the points. As the other engine, it
+  // only keeps the corners of the hull, not its points on faces and edges.
+  // Takes at most 2^32 - 1 points, indexed with 32 bits; the conflict lists,
+  // which also hold the garbage of the dead faces, use 64-bit offsets.
+  QuickHull
+};
+
+struct HullOptions {
+  // Only quickhull reads single precision points in place: the other engine
+  // and the culling of a PointsF input first copy it in float64, 24 more
+  // bytes per point on top of the 12 of the input.
+  HullEngine m_engine = HullEngine::DivideAndConquer;
+  // Runs the two halves of the recursion as parallel tasks. Null is serial.
+  // Only used by the divide and conquer engine.
+  std::shared_ptr<IExecutor> m_executor;
+  // Sub-ranges with fewer points than this are hulled serially.
+  size_t m_parallel_cutoff = 1 << 14;
+  // Directions of the interior point culling pass run before the recursion:
+  // 6, 14 or 26. 0 disables it.
+  size_t m_cull_directions = 0;
+  // Debug sink for the intermediate meshes. Null does nothing.
+  std::shared_ptr<IHullTrace> m_trace;
+  // Points read at a time from an IPointSource, at most 2^32 - 1.
+  size_t m_chunk_size = 1 << 20;
+  // Sorts the points once along a Morton curve before the divide and
+  // conquer recursion, that then splits them at octree planes without
+  // moving them. Uses 32 bytes per point instead of 56.
+  bool m_presort = false;
+  // Filled by the hull computations. Null collects nothing.
+  std::shared_ptr<HullStats> m_stats;
+};
+
+std::unique_ptr<Mesh> make_convex_hull(Points &_points,
+                                       const HullOptions &_opts = HullOptions());
+
+// Single precision points. Quickhull reads them in place, widening each one
+// exactly when used; the other engines and the culling work on a float64
+// copy, which triples the memory of the input: ask for quickhull without
+// culling to hull large float32 clouds.
+std::unique_ptr<Mesh> make_convex_hull(const PointsF &_points,
+                                       const HullOptions &_opts = HullOptions());
+
+// Streaming hull: reads the points m_chunk_size at a time, hulls every chunk
+// and inserts its vertices in the hull of the previous ones. The memory used
+// is the chunk plus at most twice the hull: the vertices that the chunks
+// bury are dropped once they outnumber the others. The engine is always
+// quickhull and the trace gets the hull after every chunk.
+std::unique_ptr<Mesh> make_convex_hull(IPointSource &_source,
+                                       const HullOptions &_opts = HullOptions());
+
+// Warm started hull of points that moved a little since the hull _prev was
+// made. _input_idx has the index in _points of every vertex of _prev and
+// gets the ones of the vertices of the result. The faces of _prev on the
+// moved vertices are kept if they are still convex, else the edges where
+// they fold inwards are flipped; then the points outside are inserted, so a
+// frame costs one pass over the points. An empty _prev, or folds that the
+// flips do not remove, start from scratch. The engine is always quickhull,
+// so there can be at most 2^32 - 1 points.
+std::unique_ptr<Mesh> make_convex_hull(const Points &_points, const Mesh &_prev,
+                                       std::vector<uint32_t> &_input_idx,
+                                       const HullOptions &_opts = HullOptions());
 
-Mesh *make_convex_hull(Points &_points);
+// Hull of the union of hulls, that can overlap or be flat, from their
+// vertices only. The engine is always quickhull.
+std::unique_ptr<Mesh> make_convex_hull(const std::vector<const Mesh *> &_hulls,
+                                       const HullOptions &_opts = HullOptions());
@@ -0,0 +1,290 @@
+#include "point_loader.hh"
+#include "file_mapping.hh"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+const size_t CHUNK_SIZE = 1 << 20;
+
+const char *skip_blanks(const char *_p, const char *_end) {
+  while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\r'))
+    ++_p;
+  return _p;
+}
+
+const char *next_line(const char *_p, const char *_end) {
+  auto nl = static_cast<const char *>(std::memchr(_p, '\n', _end - _p));
+  return nl == nullptr ? _end : nl + 1;
+}
+
+const char *parse_double(const char *_p, const char *_end, double &_val) {
+  _p = skip_blanks(_p, _end);
+  if (_p < _end && *_p == '+')
+    ++_p;
+  auto res = std::from_chars(_p, _end, _val);
+  if (res.ec != std::errc())
+    throw "Error";
+  return res.ptr;
+}
+
+// Splits [_begin, _end) in chunks that start at the beginning of a line.
+std::vector<const char *> split_lines(const char *_begin, const char *_end,
+                                      IExecutor *_exec) {
+  size_t chunk_nmbr = 1;
+  if (_exec != nullptr)
+    chunk_nmbr = std::clamp<size_t>((_end - _begin) / CHUNK_SIZE, 1,
+                                    4 * _exec->concurrency());
+  std::vector<const char *> bounds{_begin};
+  for (size_t i = 1; i < chunk_nmbr; ++i) {
+    auto p = std::max(_begin + (_end - _begin) * i / chunk_nmbr, bounds.back());
+    if (p != _begin)
+      p = next_line(p - 1, _end);
+    bounds.push_back(p);
+  }
+  bounds.push_back(_end);
+  return bounds;
+}
+
+// Counts the lines of every chunk accepted by _count, then calls _parse on
+// them with the index of their point.
+template <class CountT, class ParseT>
+void parse_lines(const std::vector<const char *> &_bounds, IExecutor *_exec,
+                 Points &_pts, CountT _count, ParseT _parse) {
+  auto chunk_nmbr = _bounds.size() - 1;
+  std::vector<size_t> offsets(chunk_nmbr + 1, 0);
+  parallel_for(_exec, chunk_nmbr, 1, [&](size_t _b, size_t _e) {
+    for (auto i = _b; i < _e; ++i) {
+      for (auto p = _bounds[i]; p < _bounds[i + 1];) {
+        auto end = next_line(p, _bounds[i + 1]);
+        if (_count(p, end))
+          ++offsets[i + 1];
+        p = end;
+      }
+    }
+  });
+  for (size_t i = 0; i < chunk_nmbr; ++i)
+    offsets[i + 1] += offsets[i];
+  _pts.resize(offsets.back());
+  parallel_for(_exec, chunk_nmbr, 1, [&](size_t _b, size_t _e) {
+    for (auto i = _b; i < _e; ++i) {
+      auto pt = _pts.data() + offsets[i];
+      for (auto p = _bounds[i]; p < _bounds[i + 1];) {
+        auto end = next_line(p, _bounds[i + 1]);
+        if (_count(p, end))
+          _parse(p, end, *pt++);
+        p = end;
+      }
+    }
+  });
+}
+
+bool is_obj_vertex(const char *_p, const char *_end) {
+  return _end - _p > 2 && _p[0] == 'v' && (_p[1] == ' ' || _p[1] == '\t');
+}
+
+enum class PlyType { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT, DOUBLE };
+
+PlyType ply_type(const std::string &_name) {
+  static const std::pair<const char *, PlyType> names[] = {
+      {"char", PlyType::INT8},     {"int8", PlyType::INT8},
+      {"uchar", PlyType::UINT8},   {"uint8", PlyType::UINT8},
+      {"short", PlyType::INT16},   {"int16", PlyType::INT16},
+      {"ushort", PlyType::UINT16}, {"uint16", PlyType::UINT16},
+      {"int", PlyType::INT32},     {"int32", PlyType::INT32},
+      {"uint", PlyType::UINT32},   {"uint32", PlyType::UINT32},
+      {"float", PlyType::FLOAT},   {"float32", PlyType::FLOAT},
+      {"double", PlyType::DOUBLE}, {"float64", PlyType::DOUBLE}};
+  for (const auto &name : names) {
+    if (_name == name.first)
+      return name.second;
+  }
+  throw "Error";
+}
+
+size_t ply_size(PlyType _type) {
+  static const size_t sizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+  return sizes[static_cast<size_t>(_type)];
+}
+
+template <class ValT>
+double read_as(const char *_p, bool _swap) {
+  char bytes[sizeof(ValT)];
+  std::memcpy(bytes, _p, sizeof(ValT));
+  if (_swap)
+    std::reverse(bytes, bytes + sizeof(ValT));
+  ValT val;
+  std::memcpy(&val, bytes, sizeof(ValT));
+  return static_cast<double>(val);
+}
+
+double read_scalar(const char *_p, PlyType _type, bool _swap) {
+  switch (_type) {
+  case PlyType::INT8: return read_as<int8_t>(_p, _swap);
+  case PlyType::UINT8: return read_as<uint8_t>(_p, _swap);
+  case PlyType::INT16: return read_as<int16_t>(_p, _swap);
+  case PlyType::UINT16: return read_as<uint16_t>(_p, _swap);
+  case PlyType::INT32: return read_as<int32_t>(_p, _swap);
+  case PlyType::UINT32: return read_as<uint32_t>(_p, _swap);
+  case PlyType::FLOAT: return read_as<float>(_p, _swap);
+  case PlyType::DOUBLE: return read_as<double>(_p, _swap);
+  }
+  return 0;
+}
+
+struct PlyElement {
+  std::string m_name;
+  size_t m_size = 0;
+  // Bytes of an item in a binary file, 0 if it has lists.
+  size_t m_stride = 0;
+  bool m_has_lists = false;
+  // Of x, y, z: position in an ASCII line, offset and type in binary.
+  std::array<size_t, 3> m_index{};
+  std::array<size_t, 3> m_offset{};
+  std::array<PlyType, 3> m_type{};
+  // Bit i is set when the coordinate i is a property.
+  unsigned m_found = 0;
+  size_t m_prop_nmbr = 0;
+};
+
+} // namespace
+
+void load_obj_points(const std::string &_flnm, Points &_pts,
+                     IExecutor *_exec) {
+  FileMapping file(_flnm);
+  auto end = file.data() + file.size();
+  parse_lines(split_lines(file.data(), end, _exec), _exec, _pts,
+              is_obj_vertex,
+              [](const char *_p, const char *_end, Geo::VectorD3 &_pt) {
+                _p += 2;
+                for (auto &coord : _pt)
+                  _p = parse_double(_p, _end, coord);
+              });
+}
+
+void load_ply_points(const std::string &_flnm, Points &_pts,
+                     IExecutor *_exec) {
+  FileMapping file(_flnm);
+  auto beg = file.data(), end = file.data() + file.size();
+  std::vector<PlyElement> elems;
+  std::string format;
+  bool header_done = false;
+  for (auto p = beg; p < end && !header_done;) {
+    auto line_end = next_line(p, end);
+    std::istringstream line(std::string(p, line_end));
+    p = line_end;
+    std::string key;
+    line >> key;
+    if (key == "format")
+      line >> format;
+    else if (key == "element") {
+      elems.emplace_back();
+      line >> elems.back().m_name >> elems.back().m_size;
+    } else if (key == "property" && !elems.empty()) {
+      auto &elem = elems.back();
+      std::string type, name;
+      line >> type;
+      if (type == "list") {
+        elem.m_has_lists = true;
+        line >> type >> type;
+      }
+      line >> name;
+      for (size_t i = 0; i < 3; ++i) {
+        if (name.size() == 1 && name[0] == "xyz"[i]) {
+          elem.m_index[i] = elem.m_prop_nmbr;
+          elem.m_offset[i] = elem.m_stride;
+          elem.m_type[i] = ply_type(type);
+          elem.m_found |= 1u << i;
+        }
+      }
+      elem.m_stride += ply_size(ply_type(type));
+      ++elem.m_prop_nmbr;
+    } else if (key == "end_header") {
+      header_done = true;
+      beg = p;
+    }
+  }
+  auto vert = std::find_if(elems.begin(), elems.end(),
+                           [](const PlyElement &_el) {
+                             return _el.m_name == "vertex";
+                           });
+  if (!header_done || vert == elems.end() || vert->m_has_lists ||
+      vert->m_found != 7)
+    throw "Error";
+
+  if (format == "ascii") {
+    // An item per line: skips the lines of the elements before vertex.
+    size_t skip = 0;
+    for (auto it = elems.begin(); it != vert; ++it)
+      skip += it->m_size;
+    for (; skip > 0 && beg < end; --skip)
+      beg = next_line(beg, end);
+    auto vert_end = beg;
+    for (size_t i = 0; i < vert->m_size && vert_end < end; ++i)
+      vert_end = next_line(vert_end, end);
+    const auto &index = vert->m_index;
+    auto last = *std::max_element(index.begin(), index.end());
+    parse_lines(split_lines(beg, vert_end, _exec), _exec, _pts,
+                [](const char *_p, const char *_end) {
+                  return skip_blanks(_p, _end) < _end &&
+                         *skip_blanks(_p, _end) != '\n';
+                },
+                [&index, last](const char *_p, const char *_end,
+                               Geo::VectorD3 &_pt) {
+                  double val;
+                  for (size_t i = 0; i <= last; ++i) {
+                    _p = parse_double(_p, _end, val);
+                    for (size_t j = 0; j < 3; ++j) {
+                      if (index[j] == i)
+                        _pt[j] = val;
+                    }
+                  }
+                });
+    if (_pts.size() != vert->m_size)
+      throw "Error";
+    return;
+  }
+
+  bool swap;
+  if (format == "binary_little_endian" || format == "binary_big_endian") {
+    swap = little_endian_host() != (format == "binary_little_endian");
+  } else
+    throw "Error";
+  for (auto it = elems.begin(); it != vert; ++it) {
+    // The division keeps a huge element from wrapping beg around.
+    if (it->m_has_lists ||
+        (it->m_stride > 0 && it->m_size > size_t(end - beg) / it->m_stride))
+      throw "Error";
+    beg += it->m_size * it->m_stride;
+  }
+  if (vert->m_size > size_t(end - beg) / vert->m_stride)
+    throw "Error";
+  _pts.resize(vert->m_size);
+  parallel_for(_exec, _pts.size(), CHUNK_SIZE / vert->m_stride,
+               [&](size_t _b, size_t _e) {
+                 for (auto i = _b; i < _e; ++i) {
+                   auto item = beg + i * vert->m_stride;
+                   for (size_t j = 0; j < 3; ++j)
+                     _pts[i][j] = read_scalar(item + vert->m_offset[j],
+                                              vert->m_type[j], swap);
+                 }
+               });
+}
+
+void load_points(const std::string &_flnm, Points &_pts, IExecutor *_exec) {
+  auto dot = _flnm.find_last_of('.');
+  std::string ext = dot == std::string::npos ? "" : _flnm.substr(dot + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](char _c) { return char(std::tolower(_c)); });
+  if (ext == "obj")
+    load_obj_points(_flnm, _pts, _exec);
+  else if (ext == "ply")
+    load_ply_points(_flnm, _pts, _exec);
+  else
+    throw "Error";
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "point_hull.hh"
+
+#include <string>
+
+// Loaders of the vertices of mesh files. The file is memory mapped and
+// parsed in chunks, in parallel if _exec is given. They throw on malformed
+// input.
+
+// The 'v' lines of an OBJ file.
+void load_obj_points(const std::string &_flnm, Points &_pts,
+                     IExecutor *_exec = nullptr);
+// The x, y, z properties of the vertex element of an ASCII or binary PLY
+// file. The elements before it must have no list properties in a binary
+// file.
+void load_ply_points(const std::string &_flnm, Points &_pts,
+                     IExecutor *_exec = nullptr);
+// Chooses the loader from the extension: .obj or .ply.
+void load_points(const std::string &_flnm, Points &_pts,
+                 IExecutor *_exec = nullptr);
@@ -0,0 +1,161 @@
+#include "point_morton.hh"
+#include "predicates.hh"
+#include "range.hh"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+// The index takes the padding of the code: any number of points fits.
+struct SortKey {
+  uint64_t m_code;
+  size_t m_idx;
+};
+
+// Stable LSD radix sort on m_code, 11 bits per pass. The passes where all
+// the codes have the same digit are skipped.
+void radix_sort(std::vector<SortKey> &_keys) {
+  const size_t DIGIT_BITS = 11, PASS_NMBR = (64 + DIGIT_BITS - 1) / DIGIT_BITS;
+  const uint64_t DIGIT_MASK = (uint64_t(1) << DIGIT_BITS) - 1;
+  std::vector<std::array<size_t, size_t(1) << DIGIT_BITS>> counts(PASS_NMBR);
+  for (auto &count : counts)
+    count.fill(0);
+  for (const auto &key : _keys) {
+    for (size_t pass = 0; pass < PASS_NMBR; ++pass)
+      ++counts[pass][(key.m_code >> (pass * DIGIT_BITS)) & DIGIT_MASK];
+  }
+  std::vector<SortKey> tmp(_keys.size());
+  for (size_t pass = 0; pass < PASS_NMBR; ++pass) {
+    auto &count = counts[pass];
+    if (std::find(count.begin(), count.end(), _keys.size()) != count.end())
+      continue;
+    size_t pos = 0;
+    for (auto &cnt : count)
+      pos += std::exchange(cnt, pos);
+    for (const auto &key : _keys)
+      tmp[count[(key.m_code >> (pass * DIGIT_BITS)) & DIGIT_MASK]++] = key;
+    _keys.swap(tmp);
+  }
+}
+
+// Moves the bits of _val to every third bit.
+uint64_t spread_bits(uint64_t _val) {
+  _val &= 0x1fffff;
+  _val = (_val | _val << 32) & 0x1f00000000ffff;
+  _val = (_val | _val << 16) & 0x1f0000ff0000ff;
+  _val = (_val | _val << 8) & 0x100f00f00f00f00f;
+  _val = (_val | _val << 4) & 0x10c30c30c30c30c3;
+  _val = (_val | _val << 2) & 0x1249249249249249;
+  return _val;
+}
+
+size_t highest_bit(uint64_t _val) {
+  size_t bit = 0;
+  for (size_t step = 32; step > 0; step /= 2) {
+    if (_val >> step) {
+      _val >>= step;
+      bit += step;
+    }
+  }
+  return bit;
+}
+
+} // namespace
+
+PointsMorton::PointsMorton(const Geo::VectorD3 *_pts, size_t _size,
+                           IExecutor *_exec)
+    : m_pts(_size), m_codes(_size) {
+  if (_size == 0)
+    return;
+  Geo::Range<3> box;
+  for (size_t i = 0; i < _size; ++i)
+    box += _pts[i];
+  auto origin = box[0];
+  auto ext = box[1] - box[0];
+  auto max_ext = std::max({ext[0], ext[1], ext[2]});
+  // The same scale on every axis: the cells are cubes.
+  const double MAX_CELL = double((uint64_t(1) << AXIS_BITS) - 1);
+  double scale = 0;
+  if (max_ext > 0)
+    scale = MAX_CELL / max_ext;
+  std::vector<SortKey> keys(_size);
+  parallel_for(_exec, _size, 1 << 16, [&](size_t _b, size_t _e) {
+    for (auto i = _b; i < _e; ++i) {
+      uint64_t code = 0;
+      for (size_t c = 0; c < 3; ++c) {
+        auto cell = std::min((_pts[i][c] - origin[c]) * scale, MAX_CELL);
+        code |= spread_bits(uint64_t(cell)) << c;
+      }
+      keys[i] = {code, i};
+    }
+  });
+  radix_sort(keys);
+  parallel_for(_exec, _size, 1 << 16, [&](size_t _b, size_t _e) {
+    for (auto i = _b; i < _e; ++i) {
+      m_pts[i] = _pts[keys[i].m_idx];
+      m_codes[i] = keys[i].m_code;
+    }
+  });
+}
+
+size_t PointsMorton::split(size_t _begin, size_t _end, size_t &_coord) {
+  auto diff = m_codes[_begin] ^ m_codes[_end - 1];
+  if (diff == 0 || _end - _begin <= MEDIAN_SPLIT_MAX)
+    return median_split(_begin, _end, _coord);
+  // The codes share the bits above the highest different one: it is 0 in a
+  // first part of the range and 1 in the rest.
+  auto bit = highest_bit(diff);
+  auto mid = std::partition_point(
+                 m_codes.begin() + _begin, m_codes.begin() + _end,
+                 [bit](uint64_t _code) { return ((_code >> bit) & 1) == 0; }) -
+             m_codes.begin();
+  if (mid - _begin < 2 || _end - mid < 2)
+    return median_split(_begin, _end, _coord);
+  _coord = bit % 3;
+  return mid;
+}
+
+// Splits at the median of the longest side of the box of the range, as the
+// recursion without presort does. The halves are sorted again by code.
+size_t PointsMorton::median_split(size_t _begin, size_t _end, size_t &_coord) {
+  Geo::Range<3> box;
+  for (auto i = _begin; i < _end; ++i)
+    box += m_pts[i];
+  auto ext = box[1] - box[0];
+  _coord = 0;
+  for (size_t c = 1; c < 3; ++c) {
+    if (ext[c] > ext[_coord])
+      _coord = c;
+  }
+  std::vector<std::pair<Geo::VectorD3, uint64_t>> pts(_end - _begin);
+  for (auto i = _begin; i < _end; ++i)
+    pts[i - _begin] = {m_pts[i], m_codes[i]};
+  auto mid = pts.size() / 2;
+  auto c = _coord;
+  std::nth_element(pts.begin(), pts.begin() + mid, pts.end(),
+                   [c](const auto &_a, const auto &_b) {
+                     return Geo::perturbed_less(_a.first, _b.first, c);
+                   });
+  // The points equal to the median go to the second half, or to the first
+  // one if it would be empty.
+  auto median = pts[mid].first;
+  auto not_equal = [&median](const auto &_a) { return _a.first != median; };
+  auto left_end = std::partition(pts.begin(), pts.begin() + mid, not_equal);
+  if (left_end != pts.begin())
+    mid = left_end - pts.begin();
+  else
+    mid = std::partition(pts.begin() + mid, pts.end(), std::not_fn(not_equal)) -
+          pts.begin();
+  auto by_code = [](const auto &_a, const auto &_b) {
+    return _a.second < _b.second;
+  };
+  std::sort(pts.begin(), pts.begin() + mid, by_code);
+  std::sort(pts.begin() + mid, pts.end(), by_code);
+  for (auto i = _begin; i < _end; ++i)
+    std::tie(m_pts[i], m_codes[i]) = pts[i - _begin];
+  return _begin + mid;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "executor.hh"
+#include "vector.hh"
+
+#include <cstdint>
+#include <vector>
+
+// Copy of the points sorted once along a Morton curve. The points of a cell
+// of the octree of the bounding cube are consecutive, so the recursion
+// splits a range at the first point past the plane of the highest bit its
+// codes differ in: a binary search, without reading or moving the points.
+// The small ranges, and the ones that no bit splits in two parts of 2
+// points or more, like the points closer than the resolution of the codes,
+// fall back to a median split.
+class PointsMorton {
+public:
+  PointsMorton(const Geo::VectorD3 *_pts, size_t _size,
+               IExecutor *_exec = nullptr);
+
+  size_t size() const { return m_pts.size(); }
+  const Geo::VectorD3 &point(size_t _i) const { return m_pts[_i]; }
+
+  // Splits the points [_begin, _end) with a plane orthogonal to the axis
+  // _coord. Returns the first point of the second part. The points on the
+  // plane are split by Geo::perturbed_less() and equal points are never
+  // split: the second part is empty if all the points are equal.
+  size_t split(size_t _begin, size_t _end, size_t &_coord);
+
+private:
+  size_t median_split(size_t _begin, size_t _end, size_t &_coord);
+
+  // Bits of the codes per axis.
+  static constexpr size_t AXIS_BITS = 21;
+  // Ranges up to this size split at the median, that the merge of the
+  // leaves of 3 points handles best.
+  static constexpr size_t MEDIAN_SPLIT_MAX = 64;
+
+  std::vector<Geo::VectorD3> m_pts;
+  std::vector<uint64_t> m_codes;
+};
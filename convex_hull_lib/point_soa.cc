@@ -0,0 +1,211 @@
+#include "point_soa.hh"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SOA_SSE2
+#endif
+
+namespace {
+
+void min_max(const double *_x, size_t _size, double &_min, double &_max) {
+  _min = std::numeric_limits<double>::max();
+  _max = std::numeric_limits<double>::lowest();
+  size_t i = 0;
+#ifdef SOA_SSE2
+  // Two accumulators per side hide the latency of minpd and maxpd.
+  auto lo0 = _mm_set1_pd(_min), lo1 = lo0;
+  auto hi0 = _mm_set1_pd(_max), hi1 = hi0;
+  for (; i + 4 <= _size; i += 4) {
+    auto a = _mm_loadu_pd(_x + i);
+    auto b = _mm_loadu_pd(_x + i + 2);
+    lo0 = _mm_min_pd(lo0, a);
+    lo1 = _mm_min_pd(lo1, b);
+    hi0 = _mm_max_pd(hi0, a);
+    hi1 = _mm_max_pd(hi1, b);
+  }
+  alignas(16) double lo[2], hi[2];
+  _mm_store_pd(lo, _mm_min_pd(lo0, lo1));
+  _mm_store_pd(hi, _mm_max_pd(hi0, hi1));
+  _min = std::min(lo[0], lo[1]);
+  _max = std::max(hi[0], hi[1]);
+#endif
+  for (; i < _size; ++i) {
+    _min = std::min(_min, _x[i]);
+    _max = std::max(_max, _x[i]);
+  }
+}
+
+// Counts the elements of _x less than _pivot.
+size_t count_less(const double *_x, size_t _size, double _pivot) {
+  size_t less = 0;
+  size_t i = 0;
+#ifdef SOA_SSE2
+  static const int BITS[] = {0, 1, 1, 2};
+  auto pivot = _mm_set1_pd(_pivot);
+  for (; i + 2 <= _size; i += 2)
+    less += BITS[_mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(_x + i), pivot))];
+#endif
+  for (; i < _size; ++i)
+    less += _x[i] < _pivot;
+  return less;
+}
+
+// Counts the elements of _x greater than _pivot.
+size_t count_greater(const double *_x, size_t _size, double _pivot) {
+  size_t greater = 0;
+  size_t i = 0;
+#ifdef SOA_SSE2
+  static const int BITS[] = {0, 1, 1, 2};
+  auto pivot = _mm_set1_pd(_pivot);
+  for (; i + 2 <= _size; i += 2)
+    greater += BITS[_mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(_x + i), pivot))];
+#endif
+  for (; i < _size; ++i)
+    greater += _x[i] > _pivot;
+  return greater;
+}
+
+} // namespace
+
+PointsSoA::PointsSoA(const Geo::VectorD3 *_pts, size_t _size,
+                     IExecutor *_exec)
+    : m_size(_size), m_select(_size) {
+  for (size_t buf = 0; buf < 2; ++buf) {
+    for (size_t c = 0; c < 3; ++c)
+      m_coord[buf][c].resize(_size);
+  }
+  parallel_for(_exec, _size, 1 << 16, [this, _pts](size_t _b, size_t _e) {
+    for (auto i = _b; i < _e; ++i) {
+      for (size_t c = 0; c < 3; ++c)
+        m_coord[0][c][i] = _pts[i][c];
+    }
+  });
+}
+
+Geo::Range<3> PointsSoA::box(size_t _buf, size_t _begin, size_t _end) const {
+  Geo::VectorD3 lo, hi;
+  for (size_t c = 0; c < 3; ++c)
+    min_max(m_coord[_buf][c].data() + _begin, _end - _begin, lo[c], hi[c]);
+  Geo::Range<3> res;
+  res.set(false, lo);
+  res.set(true, hi);
+  return res;
+}
+
+double PointsSoA::select_median(const double *_x, size_t _begin,
+                                size_t _end) {
+  auto size = _end - _begin;
+  auto mid = _begin + size / 2;
+  auto *sel = m_select.data();
+  if (size >= SAMPLED_SELECT_MIN) {
+    // Floyd and Rivest: two pivots from a sorted sample bracket the median
+    // with high probability, a counting pass checks it and only the values
+    // between them go through nth_element.
+    double sample[SAMPLE_SIZE];
+    for (size_t i = 0; i < SAMPLE_SIZE; ++i)
+      sample[i] = _x[_begin + i * size / SAMPLE_SIZE];
+    std::sort(sample, sample + SAMPLE_SIZE);
+    auto lo = sample[SAMPLE_SIZE / 2 - SAMPLE_MARGIN];
+    auto hi = sample[SAMPLE_SIZE / 2 + SAMPLE_MARGIN];
+    auto below = count_less(_x + _begin, size, lo);
+    auto not_above = size - count_greater(_x + _begin, size, hi);
+    auto rank = size / 2;
+    if (below <= rank && rank < not_above) {
+      auto out = sel + _begin;
+      for (auto i = _begin; i < _end; ++i) {
+        *out = _x[i];
+        out += (_x[i] >= lo) & (_x[i] <= hi);
+      }
+      auto med = sel + _begin + (rank - below);
+      std::nth_element(sel + _begin, med, out);
+      return *med;
+    }
+  }
+  std::copy(_x + _begin, _x + _end, sel + _begin);
+  std::nth_element(sel + _begin, sel + mid, sel + _end);
+  return sel[mid];
+}
+
+size_t PointsSoA::split(size_t _buf, size_t _begin, size_t _end, size_t _c) {
+  const auto *x = m_coord[_buf][_c].data();
+  auto mid = _begin + (_end - _begin) / 2;
+  auto median = select_median(x, _begin, _end);
+  // The points equal to the median fill the first half after the smaller
+  // ones.
+  auto equal_quota =
+      mid - _begin - count_less(x + _begin, _end - _begin, median);
+  auto left_equal = equal_quota;
+  // Without branches: every point is written both at the end of the first
+  // half and at the start of the second, and only the position of its side
+  // moves on. The next point overwrites the other copy.
+  const auto *in_x = m_coord[_buf][0].data();
+  const auto *in_y = m_coord[_buf][1].data();
+  const auto *in_z = m_coord[_buf][2].data();
+  auto *out_x = m_coord[1 - _buf][0].data();
+  auto *out_y = m_coord[1 - _buf][1].data();
+  auto *out_z = m_coord[1 - _buf][2].data();
+  auto left = _begin, right = _end - 1;
+  for (auto i = _begin; i < _end; ++i) {
+    auto px = in_x[i], py = in_y[i], pz = in_z[i], val = x[i];
+    out_x[left] = px;
+    out_y[left] = py;
+    out_z[left] = pz;
+    out_x[right] = px;
+    out_y[right] = py;
+    out_z[right] = pz;
+    size_t is_equal = val == median;
+    size_t go_left = (val < median) | (is_equal & (equal_quota > 0));
+    equal_quota -= is_equal & go_left;
+    left += go_left;
+    right -= 1 - go_left;
+  }
+  if (left_equal > 0)
+    mid = order_ties(1 - _buf, _begin, mid, _end, _c, median);
+  return mid;
+}
+
+size_t PointsSoA::order_ties(size_t _buf, size_t _begin, size_t _mid,
+                             size_t _end, size_t _c, double _median) {
+  auto &coord = m_coord[_buf];
+  auto swap_points = [&coord](size_t _i, size_t _j) {
+    for (size_t c = 0; c < 3; ++c)
+      std::swap(coord[c][_i], coord[c][_j]);
+  };
+  // The ties go to the end of the first half and to the start of the
+  // second, where they are sorted together.
+  const auto *x = coord[_c].data();
+  auto lo = _mid, hi = _mid;
+  for (auto i = _mid; i-- > _begin;) {
+    if (x[i] == _median)
+      swap_points(i, --lo);
+  }
+  for (auto i = _mid; i < _end; ++i) {
+    if (x[i] == _median)
+      swap_points(i, hi++);
+  }
+  std::vector<Geo::VectorD3> ties(hi - lo);
+  for (auto i = lo; i < hi; ++i)
+    ties[i - lo] = point(_buf, i);
+  std::sort(ties.begin(), ties.end());
+  for (auto i = lo; i < hi; ++i) {
+    for (size_t c = 0; c < 3; ++c)
+      coord[c][i] = ties[i - lo][c];
+  }
+  auto left = _mid - lo;
+  if (left == 0 || hi == _mid || ties[left - 1] != ties[left])
+    return _mid;
+  // A run of equal points goes to the second half, or to the first one if
+  // it would be empty.
+  auto run_beg = left - 1;
+  while (run_beg > 0 && ties[run_beg - 1] == ties[left])
+    --run_beg;
+  if (lo + run_beg > _begin)
+    return lo + run_beg;
+  auto run_end = left + 1;
+  while (run_end < ties.size() && ties[run_end] == ties[left])
+    ++run_end;
+  return lo + run_end;
+}
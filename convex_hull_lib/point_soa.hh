@@ -0,0 +1,51 @@
+#pragma once
+
+#include "executor.hh"
+#include "range.hh"
+#include "vector.hh"
+
+#include <vector>
+
+// Points with every coordinate in its own array, so that the passes reading
+// one coordinate of many points go through contiguous memory. There are two
+// buffers of points: split() moves a range from one to the other, so the
+// levels of the divide and conquer recursion alternate between them and
+// never copy back. Disjoint ranges can be split at the same time.
+class PointsSoA {
+public:
+  PointsSoA(const Geo::VectorD3 *_pts, size_t _size,
+            IExecutor *_exec = nullptr);
+
+  size_t size() const { return m_size; }
+  Geo::VectorD3 point(size_t _buf, size_t _i) const {
+    return {m_coord[_buf][0][_i], m_coord[_buf][1][_i], m_coord[_buf][2][_i]};
+  }
+
+  // Bounding box of the points [_begin, _end) of the buffer _buf.
+  Geo::Range<3> box(size_t _buf, size_t _begin, size_t _end) const;
+  // Moves the points [_begin, _end) of the buffer _buf to the same range of
+  // the other buffer, the half with the smaller coordinate _c first. Returns
+  // the first point of the second half. The points with the coordinate of
+  // the median are ordered by Geo::perturbed_less() and equal points are
+  // never split, so the halves can differ in size: one is empty if all the
+  // points are equal.
+  size_t split(size_t _buf, size_t _begin, size_t _end, size_t _c);
+
+private:
+  // Ranges from this size select the median in a sampled window.
+  static constexpr size_t SAMPLED_SELECT_MIN = 1 << 15;
+  static constexpr size_t SAMPLE_SIZE = 1024;
+  // Sample positions on each side of the median that make the window.
+  static constexpr size_t SAMPLE_MARGIN = 48;
+
+  double select_median(const double *_x, size_t _begin, size_t _end);
+  // Sorts the points of the buffer _buf equal to _median on the axis _c on
+  // both sides of _mid and moves it off the runs of equal points.
+  size_t order_ties(size_t _buf, size_t _begin, size_t _mid, size_t _end,
+                    size_t _c, double _median);
+
+  size_t m_size = 0;
+  std::vector<double> m_coord[2][3];
+  // Copy of the split coordinate, where the median is selected.
+  std::vector<double> m_select;
+};
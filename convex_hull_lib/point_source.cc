@@ -0,0 +1,49 @@
+#include "point_source.hh"
+#include "file_mapping.hh"
+
+#include <fstream>
+
+namespace {
+
+struct CallbackSource : public IPointSource {
+  explicit CallbackSource(const ReadFunction &_fn) : m_fn(_fn) {}
+  size_t read(Geo::VectorD3 *_buf, size_t _max) override {
+    return m_fn(_buf, _max);
+  }
+  ReadFunction m_fn;
+};
+
+struct RawFileSource : public IPointSource {
+  explicit RawFileSource(const std::string &_flnm)
+      : m_file(_flnm, std::ios::binary) {
+    if (!m_file)
+      throw "Error";
+  }
+  size_t read(Geo::VectorD3 *_buf, size_t _max) override {
+    static_assert(sizeof(Geo::VectorD3) == 3 * sizeof(double),
+                  "Points are read in place");
+    m_file.read(reinterpret_cast<char *>(_buf),
+                _max * sizeof(Geo::VectorD3));
+    auto nmbr = static_cast<size_t>(m_file.gcount()) / sizeof(Geo::VectorD3);
+    if (!little_endian_host()) {
+      for (size_t i = 0; i < nmbr; ++i) {
+        for (auto &coord : _buf[i])
+          swap_bytes(coord);
+      }
+    }
+    return nmbr;
+  }
+  std::ifstream m_file;
+};
+
+} // namespace
+
+std::shared_ptr<IPointSource>
+IPointSource::make_callback(const ReadFunction &_fn) {
+  return std::make_shared<CallbackSource>(_fn);
+}
+
+std::shared_ptr<IPointSource>
+IPointSource::make_raw_file(const std::string &_flnm) {
+  return std::make_shared<RawFileSource>(_flnm);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "vector.hh"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+// Sequential reader of points that may not fit in memory.
+struct IPointSource {
+  virtual ~IPointSource() = default;
+
+  // Copies up to _max next points in _buf. Returns how many it copied: 0
+  // means the source is exhausted.
+  virtual size_t read(Geo::VectorD3 *_buf, size_t _max) = 0;
+
+  using ReadFunction = std::function<size_t(Geo::VectorD3 *, size_t)>;
+  static std::shared_ptr<IPointSource> make_callback(const ReadFunction &_fn);
+  // File of packed little endian float64 triples x, y, z.
+  static std::shared_ptr<IPointSource> make_raw_file(const std::string &_flnm);
+};
@@ -0,0 +1,275 @@
+#include "predicates.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+
+// Shewchuk, Adaptive Precision Floating-Point Arithmetic and Fast Robust
+// Geometric Predicates. An expansion is a sum of non overlapping doubles
+// sorted by increasing magnitude. The zero components are dropped, so the
+// expansions of exact differences stay short. The components are on the
+// stack: N is the most that the operations below can give, so the exact
+// fallbacks allocate nothing.
+template <size_t N> struct Expansion {
+  std::array<double, N> m_comp;
+  size_t m_size = 0;
+
+  void push_back(double _c) { m_comp[m_size++] = _c; }
+  const double *begin() const { return m_comp.data(); }
+  const double *end() const { return m_comp.data() + m_size; }
+};
+
+const double EPS = std::ldexp(1., -53);
+const double ORIENT2D_BOUND = (3 + 16 * EPS) * EPS;
+const double ORIENT3D_BOUND = (7 + 56 * EPS) * EPS;
+
+void two_sum(double _a, double _b, double &_x, double &_y) {
+  _x = _a + _b;
+  auto b_virt = _x - _a;
+  auto a_virt = _x - b_virt;
+  _y = (_a - a_virt) + (_b - b_virt);
+}
+
+Expansion<2> two_diff(double _a, double _b) {
+  double x, y;
+  two_sum(_a, -_b, x, y);
+  Expansion<2> h;
+  if (y != 0)
+    h.push_back(y);
+  if (x != 0)
+    h.push_back(x);
+  return h;
+}
+
+// Adds _b to _e, that must have room for one more component.
+template <size_t N> void grow(Expansion<N> &_e, double _b) {
+  size_t nmbr = 0;
+  auto q = _b;
+  for (size_t i = 0; i < _e.m_size; ++i) {
+    double h;
+    two_sum(q, _e.m_comp[i], q, h);
+    if (h != 0)
+      _e.m_comp[nmbr++] = h;
+  }
+  _e.m_size = nmbr;
+  if (q != 0)
+    _e.push_back(q);
+}
+
+template <size_t N, size_t M>
+Expansion<N + M> sum(const Expansion<N> &_e, const Expansion<M> &_f) {
+  Expansion<N + M> h;
+  for (auto e : _e)
+    h.push_back(e);
+  for (auto f : _f)
+    grow(h, f);
+  return h;
+}
+
+template <size_t N> Expansion<N> negate(Expansion<N> _e) {
+  for (size_t i = 0; i < _e.m_size; ++i)
+    _e.m_comp[i] = -_e.m_comp[i];
+  return _e;
+}
+
+template <size_t N> Expansion<2 * N> scale(const Expansion<N> &_e, double _b) {
+  Expansion<2 * N> h;
+  double q = 0;
+  for (size_t i = 0; i < _e.m_size; ++i) {
+    auto prod = _e.m_comp[i] * _b;
+    auto err = std::fma(_e.m_comp[i], _b, -prod);
+    if (i == 0) {
+      if (err != 0)
+        h.push_back(err);
+      q = prod;
+      continue;
+    }
+    double h0, h1;
+    two_sum(q, err, q, h0);
+    two_sum(prod, q, q, h1);
+    if (h0 != 0)
+      h.push_back(h0);
+    if (h1 != 0)
+      h.push_back(h1);
+  }
+  if (q != 0)
+    h.push_back(q);
+  return h;
+}
+
+template <size_t N, size_t M>
+Expansion<2 * N * M> product(const Expansion<N> &_e, const Expansion<M> &_f) {
+  Expansion<2 * N * M> res;
+  for (auto f : _f) {
+    for (auto h : scale(_e, f))
+      grow(res, h);
+  }
+  return res;
+}
+
+template <size_t N> double sign(const Expansion<N> &_e) {
+  for (auto i = _e.m_size; i-- > 0;) {
+    if (_e.m_comp[i] != 0)
+      return _e.m_comp[i] > 0 ? 1. : -1.;
+  }
+  return 0;
+}
+
+} // namespace
+
+namespace Geo {
+
+double orient3d(const VectorD3 &_a, const VectorD3 &_b, const VectorD3 &_c,
+                const VectorD3 &_d) {
+  // Determinant of the rows _a - _d, _b - _d, _c - _d, which is minus the
+  // wanted value.
+  auto adx = _a[0] - _d[0], ady = _a[1] - _d[1], adz = _a[2] - _d[2];
+  auto bdx = _b[0] - _d[0], bdy = _b[1] - _d[1], bdz = _b[2] - _d[2];
+  auto cdx = _c[0] - _d[0], cdy = _c[1] - _d[1], cdz = _c[2] - _d[2];
+  auto bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+  auto cdxady = cdx * ady, adxcdy = adx * cdy;
+  auto adxbdy = adx * bdy, bdxady = bdx * ady;
+  auto det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) +
+             cdz * (adxbdy - bdxady);
+  auto permanent = (std::fabs(bdxcdy) + std::fabs(cdxbdy)) * std::fabs(adz) +
+                   (std::fabs(cdxady) + std::fabs(adxcdy)) * std::fabs(bdz) +
+                   (std::fabs(adxbdy) + std::fabs(bdxady)) * std::fabs(cdz);
+  if (std::fabs(det) > ORIENT3D_BOUND * permanent)
+    return -det;
+
+  Expansion<2> ad[3], bd[3], cd[3];
+  for (size_t i = 0; i < 3; ++i) {
+    ad[i] = two_diff(_a[i], _d[i]);
+    bd[i] = two_diff(_b[i], _d[i]);
+    cd[i] = two_diff(_c[i], _d[i]);
+  }
+  auto minor = [](const Expansion<2> &_x0, const Expansion<2> &_y1,
+                  const Expansion<2> &_x1, const Expansion<2> &_y0) {
+    return sum(product(_x0, _y1), negate(product(_x1, _y0)));
+  };
+  auto exact = sum(sum(product(ad[2], minor(bd[0], cd[1], cd[0], bd[1])),
+                       product(bd[2], minor(cd[0], ad[1], ad[0], cd[1]))),
+                   product(cd[2], minor(ad[0], bd[1], bd[0], ad[1])));
+  return -sign(exact);
+}
+
+double orient2d(const VectorD2 &_a, const VectorD2 &_b, const VectorD2 &_c) {
+  auto left = (_a[0] - _c[0]) * (_b[1] - _c[1]);
+  auto right = (_a[1] - _c[1]) * (_b[0] - _c[0]);
+  auto det = left - right;
+  if (std::fabs(det) > ORIENT2D_BOUND * (std::fabs(left) + std::fabs(right)))
+    return det;
+
+  auto exact = sum(product(two_diff(_a[0], _c[0]), two_diff(_b[1], _c[1])),
+                   negate(product(two_diff(_a[1], _c[1]),
+                                  two_diff(_b[0], _c[0]))));
+  return sign(exact);
+}
+
+namespace {
+
+// Sign of the determinant of the rows (_pts[r][_axes[0]], ...,
+// _pts[r][_axes[_k - 1]], 1), r <= _k, that is 0 without the perturbation.
+// The perturbation adds eps^(2^(3 * r + 2 - c)) to the coordinate c of the
+// point of rank r in the decreasing lexicographic order. The determinant is
+// then a polynomial in eps and its sign is the one of the first nonzero
+// coefficient by increasing exponent. A coefficient is the determinant of
+// the matrix where the rows of the perturbed entries are replaced by the
+// unit rows of their columns: it is expanded on them down to a minor of
+// order 1, 2 or 3.
+int sos_sign(const VectorD3 *const *_pts, size_t _k, const size_t *_axes) {
+  const size_t MAX_ROWS = 4;
+  size_t rank[MAX_ROWS];
+  int parity = 1;
+  for (size_t i = 0; i <= _k; ++i) {
+    rank[i] = i;
+    for (auto j = i; j > 0 && *_pts[rank[j - 1]] < *_pts[rank[j]]; --j) {
+      std::swap(rank[j - 1], rank[j]);
+      parity = -parity;
+    }
+  }
+  for (size_t i = 0; i < _k; ++i) {
+    if (*_pts[rank[i]] == *_pts[rank[i + 1]])
+      return 0;
+  }
+  // The perturbed entries by increasing exponent.
+  struct Entry {
+    size_t m_row, m_col;
+  };
+  Entry entries[MAX_ROWS * 3];
+  size_t entry_nmbr = 0;
+  for (size_t r = 0; r <= _k; ++r) {
+    for (size_t c = 3; c-- > 0;) {
+      for (size_t col = 0; col < _k; ++col) {
+        if (_axes[col] == c)
+          entries[entry_nmbr++] = {r, col};
+      }
+    }
+  }
+  auto coord = [_pts, _axes, &rank](size_t _row, size_t _col) {
+    return (*_pts[rank[_row]])[_axes[_col]];
+  };
+  for (size_t mask = 1; mask < (size_t(1) << entry_nmbr); ++mask) {
+    // Rows and columns of the minor, the column _k is the one of the 1s.
+    size_t rows[MAX_ROWS], cols[MAX_ROWS];
+    for (size_t i = 0; i <= _k; ++i)
+      rows[i] = cols[i] = i;
+    auto size = _k + 1;
+    int coef = parity;
+    bool zero = false;
+    for (size_t e = 0; e < entry_nmbr && !zero; ++e) {
+      if (!(mask >> e & 1))
+        continue;
+      auto pr = size_t(std::find(rows, rows + size, entries[e].m_row) - rows);
+      auto pc = size_t(std::find(cols, cols + size, entries[e].m_col) - cols);
+      // Two unit rows in the same row or column.
+      zero = pr == size || pc == size;
+      if (zero)
+        break;
+      if ((pr + pc) % 2)
+        coef = -coef;
+      std::copy(rows + pr + 1, rows + size, rows + pr);
+      std::copy(cols + pc + 1, cols + size, cols + pc);
+      --size;
+    }
+    if (zero)
+      continue;
+    double minor = 1;
+    if (size == 2)
+      minor = coord(rows[0], cols[0]) - coord(rows[1], cols[0]);
+    else if (size == 3)
+      minor = orient2d({coord(rows[0], cols[0]), coord(rows[0], cols[1])},
+                       {coord(rows[1], cols[0]), coord(rows[1], cols[1])},
+                       {coord(rows[2], cols[0]), coord(rows[2], cols[1])});
+    if (minor != 0)
+      return minor > 0 ? coef : -coef;
+  }
+  throw "Error";
+}
+
+} // namespace
+
+int orient3d_sos(const VectorD3 &_a, const VectorD3 &_b, const VectorD3 &_c,
+                 const VectorD3 &_d) {
+  auto det = orient3d(_a, _b, _c, _d);
+  if (det != 0)
+    return det > 0 ? 1 : -1;
+  // orient3d() is minus the determinant of the rows (p, 1).
+  const VectorD3 *pts[] = {&_a, &_b, &_c, &_d};
+  const size_t axes[] = {0, 1, 2};
+  return -sos_sign(pts, 3, axes);
+}
+
+int orient2d_sos(const VectorD3 &_a, const VectorD3 &_b, const VectorD3 &_c,
+                 size_t _i, size_t _j) {
+  auto det = orient2d({_a[_i], _a[_j]}, {_b[_i], _b[_j]}, {_c[_i], _c[_j]});
+  if (det != 0)
+    return det > 0 ? 1 : -1;
+  const VectorD3 *pts[] = {&_a, &_b, &_c};
+  const size_t axes[] = {_i, _j};
+  return sos_sign(pts, 2, axes);
+}
+
+} // namespace Geo
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "vector.hh"
+
+namespace Geo {
+
+// Orientation predicates with an exact sign. A floating point error bound
+// decides the common case at the cost of the plain formula; the others are
+// evaluated again with exact expansion arithmetic. The value returned is the
+// plain determinant or an approximation of the exact one: only its sign is
+// meaningful, the magnitude must not be used.
+
+// ((_b - _a) % (_c - _a)) * (_d - _a): positive if _d is on the side where
+// _a, _b, _c look counterclockwise.
+double orient3d(const VectorD3 &_a, const VectorD3 &_b, const VectorD3 &_c,
+                const VectorD3 &_d);
+
+// (_b - _a) % (_c - _a): positive if _a, _b, _c are counterclockwise.
+double orient2d(const VectorD2 &_a, const VectorD2 &_b, const VectorD2 &_c);
+
+// The signs of the predicates above for points moved by a symbolic
+// perturbation (Edelsbrunner and Mucke, Simulation of Simplicity): they are
+// never 0 unless two of the points are equal, and they are the same for
+// every call, so the degenerate cases decide the same way everywhere. The
+// perturbation is the greater the greater the point in the lexicographic
+// order: along an axis the perturbed points are ordered by the coordinate
+// and then lexicographically, as by perturbed_less().
+int orient3d_sos(const VectorD3 &_a, const VectorD3 &_b, const VectorD3 &_c,
+                 const VectorD3 &_d);
+
+// orient2d() of the projections of _a, _b, _c on the axes _i and _j, under
+// the perturbation of orient3d_sos().
+int orient2d_sos(const VectorD3 &_a, const VectorD3 &_b, const VectorD3 &_c,
+                 size_t _i, size_t _j);
+
+// True if the perturbed _a has the smaller coordinate _c.
+inline bool perturbed_less(const VectorD3 &_a, const VectorD3 &_b, size_t _c) {
+  return _a[_c] != _b[_c] ? _a[_c] < _b[_c] : _a < _b;
+}
+
+} // namespace Geo
@@ -0,0 +1,1011 @@
+#include "quick_hull.hh"
+#include "predicates.hh"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+template <class PointT>
+double rounding_tolerance(const PointT *_pts, size_t _size) {
+  Geo::VectorD3 max_abs{};
+  for (size_t i = 0; i < _size; ++i) {
+    for (size_t j = 0; j < 3; ++j)
+      max_abs[j] = std::max(max_abs[j], std::fabs(double(_pts[i][j])));
+  }
+  // Bound of the rounding error of a point to plane distance.
+  return 3 * std::numeric_limits<double>::epsilon() *
+         (max_abs[0] + max_abs[1] + max_abs[2]);
+}
+
+// Index of the point of _pts farthest from the line through _orig along the
+// unit vector _dir.
+template <class PointT>
+size_t farthest_from_line(const PointT *_pts, size_t _size,
+                          const Geo::VectorD3 &_orig,
+                          const Geo::VectorD3 &_dir, double &_dist_sq) {
+  size_t far = 0;
+  _dist_sq = -1;
+  for (size_t i = 0; i < _size; ++i) {
+    auto dist_sq =
+        Geo::length_square((PointView::widen(_pts[i]) - _orig) % _dir);
+    if (dist_sq > _dist_sq) {
+      _dist_sq = dist_sq;
+      far = i;
+    }
+  }
+  return far;
+}
+
+// Finds 4 points that span 3 dimensions. Returns how many of them it found
+// before the points turned out to be flat.
+template <class PointT>
+size_t initial_simplex(const PointT *_pts, size_t _size, double _tol,
+                       std::array<size_t, 4> &_simplex) {
+  if (_size == 0)
+    return 0;
+  std::array<size_t, 6> extr{};
+  for (size_t i = 0; i < _size; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      if (_pts[i][j] < _pts[extr[2 * j]][j])
+        extr[2 * j] = i;
+      if (_pts[i][j] > _pts[extr[2 * j + 1]][j])
+        extr[2 * j + 1] = i;
+    }
+  }
+  double best = -1;
+  for (size_t j = 0; j < 3; ++j) {
+    auto len = double(_pts[extr[2 * j + 1]][j]) - double(_pts[extr[2 * j]][j]);
+    if (len > best) {
+      best = len;
+      _simplex[0] = extr[2 * j];
+      _simplex[1] = extr[2 * j + 1];
+    }
+  }
+  if (best <= _tol)
+    return 1;
+  auto p0 = PointView::widen(_pts[_simplex[0]]);
+  auto dir = PointView::widen(_pts[_simplex[1]]) - p0;
+  dir /= Geo::length(dir);
+  double dist_sq;
+  _simplex[2] = farthest_from_line(_pts, _size, p0, dir, dist_sq);
+  if (dist_sq <= Geo::sq(_tol))
+    return 2;
+  auto norm = dir % (PointView::widen(_pts[_simplex[2]]) - p0);
+  norm /= Geo::length(norm);
+  best = -1;
+  for (size_t i = 0; i < _size; ++i) {
+    auto dist = std::fabs(norm * (PointView::widen(_pts[i]) - p0));
+    if (dist > best) {
+      best = dist;
+      _simplex[3] = i;
+    }
+  }
+  if (best <= _tol)
+    return 3;
+  return 4;
+}
+
+// The same on the raw array of the precision of _pts.
+double rounding_tolerance(PointView _pts, size_t _size) {
+  if (_pts.data64() != nullptr)
+    return rounding_tolerance(_pts.data64(), _size);
+  return rounding_tolerance(_pts.data32(), _size);
+}
+
+size_t initial_simplex(PointView _pts, size_t _size, double _tol,
+                       std::array<size_t, 4> &_simplex) {
+  if (_pts.data64() != nullptr)
+    return initial_simplex(_pts.data64(), _size, _tol, _simplex);
+  return initial_simplex(_pts.data32(), _size, _tol, _simplex);
+}
+
+} // namespace
+
+QuickHull::FaceIdx QuickHull::new_face(VertIdx _v0, VertIdx _v1,
+                                       VertIdx _v2) {
+  FaceIdx idx;
+  if (m_free_faces.empty()) {
+    idx = static_cast<FaceIdx>(m_faces.size());
+    m_faces.emplace_back();
+  } else {
+    idx = m_free_faces.back();
+    m_free_faces.pop_back();
+    m_faces[idx] = Face();
+  }
+  auto &face = m_faces[idx];
+  face.m_vert = {_v0, _v1, _v2};
+  face.m_adj = {INVALID, INVALID, INVALID};
+  face.m_alive = true;
+  set_plane(face);
+  return idx;
+}
+
+void QuickHull::set_plane(Face &_face) const {
+  const auto &p0 = m_verts[_face.m_vert[0]];
+  const auto &p1 = m_verts[_face.m_vert[1]];
+  const auto &p2 = m_verts[_face.m_vert[2]];
+  auto norm = (p1 - p0) % (p2 - p0);
+  auto len = Geo::length(norm);
+  if (len > 0)
+    norm /= len;
+  _face.m_normal = norm;
+  _face.m_dist = norm * ((p0 + p1 + p2) / 3.);
+  // The error of the cross product over its length, times the distance of
+  // the points from the face, that the tolerance bounds.
+  _face.m_dist_err =
+      len > 0 ? 1 + 8 * Geo::length(p1 - p0) * Geo::length(p2 - p0) / len
+              : std::numeric_limits<double>::infinity();
+}
+
+bool QuickHull::outside(const Face &_face, const Geo::VectorD3 &_pt) const {
+  auto dist = _face.distance(_pt);
+  if (std::fabs(dist) > m_tol * _face.m_dist_err)
+    return dist > 0;
+  return Geo::orient3d(m_verts[_face.m_vert[0]], m_verts[_face.m_vert[1]],
+                       m_verts[_face.m_vert[2]], _pt) > 0;
+}
+
+void QuickHull::assign_conflicts(const std::vector<uint32_t> &_pts,
+                                 const std::vector<FaceIdx> &_faces) {
+  if (m_input.data64() != nullptr)
+    assign_conflicts(m_input.data64(), _pts, _faces);
+  else
+    assign_conflicts(m_input.data32(), _pts, _faces);
+}
+
+template <class PointT>
+void QuickHull::assign_conflicts(const PointT *_input,
+                                 const std::vector<uint32_t> &_pts,
+                                 const std::vector<FaceIdx> &_faces) {
+  // First pass: finds the face of every point and counts the points of
+  // every face. Second pass: fills the new slots at the end of the array.
+  std::vector<FaceIdx> targets(_pts.size(), INVALID);
+  for (auto f : _faces)
+    m_faces[f].m_confl_nmbr = 0;
+  for (size_t i = 0; i < _pts.size(); ++i) {
+    const auto &pt = PointView::widen(_input[_pts[i]]);
+    for (auto f : _faces) {
+      if (outside(m_faces[f], pt)) {
+        targets[i] = f;
+        ++m_faces[f].m_confl_nmbr;
+        break;
+      }
+    }
+  }
+  for (auto f : _faces) {
+    auto &face = m_faces[f];
+    face.m_confl_off = m_conflicts.size();
+    m_conflicts.resize(m_conflicts.size() + face.m_confl_nmbr);
+    face.m_confl_nmbr = 0;
+    face.m_far_dist = 0;
+  }
+  for (size_t i = 0; i < _pts.size(); ++i) {
+    if (targets[i] == INVALID)
+      continue;
+    auto &face = m_faces[targets[i]];
+    m_conflicts[face.m_confl_off + face.m_confl_nmbr++] = _pts[i];
+    auto dist = face.distance(PointView::widen(_input[_pts[i]]));
+    if (face.m_confl_nmbr == 1 || dist > face.m_far_dist) {
+      face.m_far_dist = dist;
+      face.m_far_pt = _pts[i];
+    }
+  }
+}
+
+bool QuickHull::add_point(uint32_t _pt, FaceIdx _face) {
+  const auto pt = m_input[_pt];
+  ++m_mark;
+  m_visible.assign(1, _face);
+  m_faces[_face].m_mark = m_mark;
+  m_horizon.clear();
+  for (size_t k = 0; k < m_visible.size(); ++k) {
+    auto f = m_visible[k];
+    for (FaceIdx i = 0; i < 3; ++i) {
+      auto &adj_face = m_faces[m_faces[f].m_adj[i]];
+      if (adj_face.m_mark == m_mark)
+        continue;
+      if (outside(adj_face, pt)) {
+        adj_face.m_mark = m_mark;
+        m_visible.push_back(m_faces[f].m_adj[i]);
+      } else
+        m_horizon.push_back({f, i});
+    }
+  }
+  // The horizon must be a single loop: every vertex starts one edge and
+  // following the edges from one of them visits all of them.
+  for (const auto &hor : m_horizon) {
+    auto v = m_faces[hor[0]].m_vert[hor[1]];
+    if (m_vert_mark[v] == m_mark)
+      return false;
+    m_vert_mark[v] = m_mark;
+    m_vert_faces[v][0] = static_cast<FaceIdx>(&hor - m_horizon.data());
+  }
+  {
+    size_t loop_size = 0;
+    auto edge = m_horizon.front();
+    do {
+      auto v = m_faces[edge[0]].m_vert[(edge[1] + 1) % 3];
+      if (m_vert_mark[v] != m_mark)
+        return false;
+      edge = m_horizon[m_vert_faces[v][0]];
+    } while (++loop_size <= m_horizon.size() && edge != m_horizon.front());
+    if (loop_size != m_horizon.size())
+      return false;
+  }
+
+  auto apex = static_cast<VertIdx>(m_verts.size());
+  m_verts.push_back(pt);
+  m_vert_input.push_back(_pt);
+  m_vert_mark.push_back(0);
+  m_vert_faces.emplace_back();
+  m_new_faces.clear();
+  for (const auto &hor : m_horizon) {
+    auto a = m_faces[hor[0]].m_vert[hor[1]];
+    auto b = m_faces[hor[0]].m_vert[(hor[1] + 1) % 3];
+    auto out_face = m_faces[hor[0]].m_adj[hor[1]];
+    auto nf = new_face(a, b, apex);
+    m_new_faces.push_back(nf);
+    m_faces[nf].m_adj[0] = out_face;
+    auto &out = m_faces[out_face];
+    for (size_t j = 0; j < 3; ++j) {
+      if (out.m_adj[j] == hor[0] && out.m_vert[j] == b)
+        out.m_adj[j] = nf;
+    }
+    m_vert_faces[a][0] = nf;
+    m_vert_faces[b][1] = nf;
+  }
+  for (auto nf : m_new_faces) {
+    auto &face = m_faces[nf];
+    face.m_adj[1] = m_vert_faces[face.m_vert[1]][0];
+    face.m_adj[2] = m_vert_faces[face.m_vert[0]][1];
+  }
+
+  m_orphans.clear();
+  for (auto f : m_visible) {
+    auto &face = m_faces[f];
+    for (uint32_t i = 0; i < face.m_confl_nmbr; ++i) {
+      auto orphan = m_conflicts[face.m_confl_off + i];
+      if (orphan != _pt)
+        m_orphans.push_back(orphan);
+    }
+    m_conflict_garbage += face.m_confl_nmbr;
+    face.m_confl_nmbr = 0;
+    face.m_alive = false;
+    m_free_faces.push_back(f);
+  }
+  assign_conflicts(m_orphans, m_new_faces);
+  m_last_face = m_new_faces.front();
+  for (auto nf : m_new_faces) {
+    if (m_faces[nf].m_confl_nmbr > 0)
+      m_pending.push_back(nf);
+  }
+  return true;
+}
+
+void QuickHull::compact_conflicts() {
+  std::vector<uint32_t> conflicts;
+  conflicts.reserve(m_conflicts.size() - m_conflict_garbage);
+  for (auto &face : m_faces) {
+    if (!face.m_alive)
+      continue;
+    auto off = conflicts.size();
+    conflicts.insert(conflicts.end(), m_conflicts.begin() + face.m_confl_off,
+                     m_conflicts.begin() + face.m_confl_off +
+                         face.m_confl_nmbr);
+    face.m_confl_off = off;
+  }
+  m_conflicts = std::move(conflicts);
+  m_conflict_garbage = 0;
+}
+
+void QuickHull::compact() {
+  std::vector<VertIdx> vert_map(m_verts.size(), INVALID);
+  VertIdx live_nmbr = 0;
+  for (const auto &face : m_faces) {
+    if (!face.m_alive)
+      continue;
+    for (auto v : face.m_vert) {
+      if (vert_map[v] == INVALID) {
+        vert_map[v] = 0;
+        ++live_nmbr;
+      }
+    }
+  }
+  if (2 * size_t(live_nmbr) >= m_verts.size())
+    return;
+  // The vertices and the faces keep their order.
+  VertIdx vert_nmbr = 0;
+  for (size_t v = 0; v < m_verts.size(); ++v) {
+    if (vert_map[v] == INVALID)
+      continue;
+    vert_map[v] = vert_nmbr;
+    m_verts[vert_nmbr] = m_verts[v];
+    m_vert_input[vert_nmbr] = m_vert_input[v];
+    ++vert_nmbr;
+  }
+  m_verts.resize(vert_nmbr);
+  m_vert_input.resize(vert_nmbr);
+  m_vert_mark.assign(vert_nmbr, 0);
+  m_vert_faces.assign(vert_nmbr, {INVALID, INVALID});
+  std::vector<FaceIdx> face_map(m_faces.size(), INVALID);
+  FaceIdx face_nmbr = 0;
+  for (size_t f = 0; f < m_faces.size(); ++f) {
+    if (m_faces[f].m_alive)
+      face_map[f] = face_nmbr++;
+  }
+  for (size_t f = 0; f < m_faces.size(); ++f) {
+    if (face_map[f] == INVALID)
+      continue;
+    auto &face = m_faces[face_map[f]];
+    face = m_faces[f];
+    for (auto &v : face.m_vert)
+      v = vert_map[v];
+    for (auto &adj : face.m_adj)
+      adj = face_map[adj];
+  }
+  m_faces.resize(face_nmbr);
+  m_free_faces.clear();
+  auto pending_end =
+      std::remove_if(m_pending.begin(), m_pending.end(),
+                     [&face_map](FaceIdx _f) { return face_map[_f] == INVALID; });
+  m_pending.erase(pending_end, m_pending.end());
+  for (auto &f : m_pending)
+    f = face_map[f];
+  m_last_face = face_map[m_last_face] != INVALID ? face_map[m_last_face] : 0;
+  compact_conflicts();
+}
+
+void QuickHull::clear() {
+  m_input = PointView();
+  m_tol = 0;
+  m_center = {};
+  m_last_face = 0;
+  m_verts.clear();
+  m_vert_input.clear();
+  m_faces.clear();
+  m_free_faces.clear();
+  m_conflicts.clear();
+  m_conflict_garbage = 0;
+  m_pending.clear();
+  m_deferred.clear();
+  m_mark = 0;
+  m_vert_mark.clear();
+  m_vert_faces.clear();
+}
+
+bool QuickHull::build(PointView _pts, size_t _size, IHullTrace *_trace) {
+  if (_size > MAX_POINTS)
+    throw "Error";
+  clear();
+  m_input = _pts;
+  m_tol = rounding_tolerance(_pts, _size);
+  std::array<size_t, 4> simplex;
+  if (initial_simplex(_pts, _size, m_tol, simplex) < 4)
+    return false;
+
+  for (auto i : simplex) {
+    m_verts.push_back(_pts[i]);
+    m_vert_input.push_back(static_cast<uint32_t>(i));
+    m_center += _pts[i] / 4.;
+  }
+  m_vert_mark.resize(4);
+  m_vert_faces.resize(4);
+  // Every face of the tetrahedron is oriented away from the opposite vertex.
+  for (VertIdx i = 0; i < 4; ++i) {
+    std::array<VertIdx, 3> tri;
+    for (VertIdx j = 0, k = 0; j < 4; ++j) {
+      if (j != i)
+        tri[k++] = j;
+    }
+    auto f = new_face(tri[0], tri[1], tri[2]);
+    if (outside(m_faces[f], m_verts[i])) {
+      std::swap(m_faces[f].m_vert[1], m_faces[f].m_vert[2]);
+      set_plane(m_faces[f]);
+    }
+  }
+  for (auto &face : m_faces) {
+    for (size_t i = 0; i < 3; ++i) {
+      auto a = face.m_vert[i], b = face.m_vert[(i + 1) % 3];
+      for (FaceIdx g = 0; g < 4; ++g) {
+        for (size_t j = 0; j < 3; ++j) {
+          if (m_faces[g].m_vert[j] == b && m_faces[g].m_vert[(j + 1) % 3] == a)
+            face.m_adj[i] = g;
+        }
+      }
+    }
+  }
+
+  std::vector<uint32_t> pts;
+  pts.reserve(_size);
+  for (uint32_t i = 0; i < _size; ++i) {
+    if (std::find(simplex.begin(), simplex.end(), i) == simplex.end())
+      pts.push_back(i);
+  }
+  m_pending = {0, 1, 2, 3};
+  assign_conflicts(pts, m_pending);
+
+  Mesh trace_mesh;
+  do {
+    while (!m_pending.empty()) {
+      auto f = m_pending.back();
+      m_pending.pop_back();
+      auto &face = m_faces[f];
+      if (!face.m_alive || face.m_confl_nmbr == 0)
+        continue;
+      auto far_pt = face.m_far_pt;
+      if (!add_point(far_pt, f)) {
+        // Rounding made the region seen from the point not a disk: the point
+        // waits until the faces around it change.
+        m_deferred.push_back(far_pt);
+        auto &face = m_faces[f];
+        auto beg = m_conflicts.begin() + face.m_confl_off;
+        auto end = beg + face.m_confl_nmbr;
+        end = std::remove(beg, end, far_pt);
+        face.m_confl_nmbr = static_cast<uint32_t>(end - beg);
+        for (auto it = beg; it != end; ++it) {
+          auto dist = face.distance(m_input[*it]);
+          if (it == beg || dist > face.m_far_dist) {
+            face.m_far_dist = dist;
+            face.m_far_pt = *it;
+          }
+        }
+        m_pending.push_back(f);
+        continue;
+      }
+      if (m_conflict_garbage > m_conflicts.size() / 2)
+        compact_conflicts();
+      if (_trace) {
+        to_mesh(trace_mesh);
+        _trace->report(trace_mesh);
+      }
+    }
+  } while (add_deferred(nullptr, _trace));
+  compact();
+  m_input = PointView();
+  return true;
+}
+
+bool QuickHull::build(const Mesh &_mesh, const uint32_t *_input) {
+  clear();
+  m_verts.assign(_mesh.m_pts.begin(), _mesh.m_pts.end());
+  m_vert_input.resize(m_verts.size());
+  if (_input != nullptr)
+    std::copy_n(_input, m_verts.size(), m_vert_input.begin());
+  else
+    std::iota(m_vert_input.begin(), m_vert_input.end(), 0);
+  m_tol = rounding_tolerance(m_verts.data(), m_verts.size());
+  std::array<size_t, 4> simplex;
+  if (initial_simplex(m_verts.data(), m_verts.size(), m_tol, simplex) < 4)
+    return false;
+  for (auto i : simplex)
+    m_center += m_verts[i] / 4.;
+  m_vert_mark.resize(m_verts.size());
+  m_vert_faces.resize(m_verts.size());
+
+  const auto *faces = &_mesh.m_faces;
+  Mesh with_faces;
+  if (faces->empty()) {
+    with_faces = _mesh;
+    with_faces.make_faces();
+    faces = &with_faces.m_faces;
+  }
+  // The directed edges grouped by their first vertex, with their face and
+  // edge index: the twin of a, b is among the edges of b.
+  std::vector<VertIdx> edge_off(m_verts.size() + 1, 0);
+  for (const auto &mesh_face : *faces) {
+    for (auto v : mesh_face.m_vert)
+      ++edge_off[v + 1];
+  }
+  std::partial_sum(edge_off.begin(), edge_off.end(), edge_off.begin());
+  std::vector<std::pair<VertIdx, FaceIdx>> edges(edge_off.back());
+  auto edge_end = edge_off;
+  for (const auto &mesh_face : *faces) {
+    const auto &vert = mesh_face.m_vert;
+    auto f = new_face(vert[0], vert[1], vert[2]);
+    for (FaceIdx i = 0; i < 3; ++i)
+      edges[edge_end[vert[i]]++] = {vert[(i + 1) % 3], 3 * f + i};
+  }
+  for (auto &face : m_faces) {
+    for (size_t i = 0; i < 3; ++i) {
+      auto a = face.m_vert[i], b = face.m_vert[(i + 1) % 3];
+      auto twin = std::find_if(
+          edges.begin() + edge_off[b], edges.begin() + edge_off[b + 1],
+          [a](const std::pair<VertIdx, FaceIdx> &_edge) {
+            return _edge.first == a;
+          });
+      if (twin == edges.begin() + edge_off[b + 1])
+        throw "Error";
+      face.m_adj[i] = twin->second / 3;
+    }
+  }
+  return true;
+}
+
+QuickHull::FaceIdx QuickHull::locate(const Geo::VectorD3 &_pt) const {
+  auto f = m_last_face;
+  if (!m_faces[f].m_alive) {
+    for (f = 0; !m_faces[f].m_alive; ++f)
+      ;
+  }
+  for (size_t step = 0; step < m_faces.size(); ++step) {
+    const auto &face = m_faces[f];
+    auto next = INVALID;
+    // The edge tried first rotates to break cycles.
+    for (size_t i = 0; i < 3 && next == INVALID; ++i) {
+      auto j = (i + step) % 3;
+      const auto &a = m_verts[face.m_vert[j]];
+      const auto &b = m_verts[face.m_vert[(j + 1) % 3]];
+      const auto &x = m_verts[face.m_vert[(j + 2) % 3]];
+      // Compares the signs: their product can underflow to zero. A point on
+      // the plane of the edge does not leave the face.
+      auto side_pt = Geo::orient3d(m_center, a, b, _pt);
+      auto side_x = Geo::orient3d(m_center, a, b, x);
+      if ((side_pt < 0 && side_x > 0) || (side_pt > 0 && side_x < 0))
+        next = face.m_adj[j];
+    }
+    if (next == INVALID)
+      return f;
+    f = next;
+  }
+  return INVALID;
+}
+
+void QuickHull::insert(PointView _pts, size_t _size, IHullTrace *_trace,
+                       const uint32_t *_input) {
+  if (_size > MAX_POINTS)
+    throw "Error";
+  if (m_faces.empty()) {
+    // Flat so far: starts again with the old and the new points.
+    std::vector<Geo::VectorD3> pts(m_verts);
+    auto old_input = m_vert_input;
+    for (size_t i = 0; i < _size; ++i)
+      pts.push_back(_pts[i]);
+    // Input index of the point _i of pts.
+    auto input_of = [&old_input, _input](size_t _i) {
+      if (_i < old_input.size())
+        return old_input[_i];
+      _i -= old_input.size();
+      return _input != nullptr ? _input[_i] : static_cast<uint32_t>(_i);
+    };
+    if (!build(pts.data(), pts.size(), _trace)) {
+      Mesh flat;
+      std::vector<size_t> index;
+      make_flat_hull(pts.data(), pts.size(), m_tol, flat, &index);
+      m_verts.assign(flat.m_pts.begin(), flat.m_pts.end());
+      m_vert_input.clear();
+      for (auto i : index)
+        m_vert_input.push_back(input_of(i));
+      return;
+    }
+    for (auto &input : m_vert_input)
+      input = input_of(input);
+    return;
+  }
+  m_tol = std::max(m_tol, rounding_tolerance(_pts, _size));
+  m_input = _pts;
+  m_deferred.clear();
+  auto ball_radius = std::numeric_limits<double>::max();
+  for (const auto &face : m_faces) {
+    if (face.m_alive) {
+      ball_radius = std::min(ball_radius, -face.distance(m_center) -
+                                              m_tol * face.m_dist_err);
+    }
+  }
+  auto ball_sq = ball_radius > 0 ? Geo::sq(ball_radius) : 0;
+  Mesh trace_mesh;
+  for (uint32_t i = 0; i < _size; ++i) {
+    if (Geo::length_square(_pts[i] - m_center) < ball_sq)
+      continue;
+    auto f = locate(_pts[i]);
+    if (f == INVALID) {
+      // The walk went round in circles: looks at all the faces.
+      for (FaceIdx g = 0; g < m_faces.size() && f == INVALID; ++g) {
+        if (m_faces[g].m_alive && outside(m_faces[g], _pts[i]))
+          f = g;
+      }
+    }
+    if (f == INVALID)
+      continue;
+    m_last_face = f;
+    if (!outside(m_faces[f], _pts[i]))
+      continue;
+    if (!add_point(i, f)) {
+      m_deferred.push_back(i);
+      continue;
+    }
+    if (_input != nullptr)
+      m_vert_input.back() = _input[i];
+    if (_trace) {
+      to_mesh(trace_mesh);
+      _trace->report(trace_mesh);
+    }
+  }
+  while (add_deferred(_input, _trace))
+    ;
+  compact();
+  m_input = PointView();
+}
+
+bool QuickHull::add_deferred(const uint32_t *_input, IHullTrace *_trace) {
+  auto deferred = std::move(m_deferred);
+  m_deferred.clear();
+  bool added = false;
+  Mesh trace_mesh;
+  for (auto i : deferred) {
+    const auto pt = m_input[i];
+    auto f = INVALID;
+    for (FaceIdx g = 0; g < m_faces.size() && f == INVALID; ++g) {
+      if (m_faces[g].m_alive && outside(m_faces[g], pt))
+        f = g;
+    }
+    if (f == INVALID)
+      continue;
+    if (!add_point(i, f)) {
+      m_deferred.push_back(i);
+      continue;
+    }
+    added = true;
+    if (_input != nullptr)
+      m_vert_input.back() = _input[i];
+    if (_trace) {
+      to_mesh(trace_mesh);
+      _trace->report(trace_mesh);
+    }
+  }
+  return added;
+}
+
+size_t QuickHull::twin_edge(FaceIdx _face, size_t _edge) const {
+  const auto &face = m_faces[_face];
+  const auto &adj = m_faces[face.m_adj[_edge]];
+  size_t j = 0;
+  while (adj.m_vert[j] != face.m_vert[(_edge + 1) % 3])
+    ++j;
+  return j;
+}
+
+size_t QuickHull::star(FaceIdx _face, VertIdx _v,
+                       std::vector<FaceIdx> &_faces) const {
+  _faces.clear();
+  auto f = _face;
+  do {
+    const auto &face = m_faces[f];
+    size_t k = 0;
+    while (face.m_vert[k] != _v)
+      ++k;
+    _faces.push_back(f);
+    f = face.m_adj[k];
+  } while (f != _face && _faces.size() <= m_faces.size());
+  return _faces.size();
+}
+
+bool QuickHull::flip_edge(FaceIdx _face, size_t _edge) {
+  auto g = m_faces[_face].m_adj[_edge];
+  auto a = m_faces[_face].m_vert[_edge];
+  auto b = m_faces[_face].m_vert[(_edge + 1) % 3];
+  auto c = m_faces[_face].m_vert[(_edge + 2) % 3];
+  auto j = twin_edge(_face, _edge);
+  auto d = m_faces[g].m_vert[(j + 2) % 3];
+  // The new faces must face away from the inner point, else the surface
+  // folds over itself.
+  if (c == d ||
+      Geo::orient3d(m_verts[c], m_verts[a], m_verts[d], m_center) >= 0 ||
+      Geo::orient3d(m_verts[d], m_verts[b], m_verts[c], m_center) >= 0)
+    return false;
+  // The new edge c, d must not be on the surface already.
+  star(_face, c, m_star);
+  for (auto f : m_star) {
+    for (auto v : m_faces[f].m_vert) {
+      if (v == d)
+        return false;
+    }
+  }
+  auto f_bc = m_faces[_face].m_adj[(_edge + 1) % 3];
+  auto f_ca = m_faces[_face].m_adj[(_edge + 2) % 3];
+  auto g_ad = m_faces[g].m_adj[(j + 1) % 3];
+  auto g_db = m_faces[g].m_adj[(j + 2) % 3];
+  auto replace_adj = [this](FaceIdx _f, FaceIdx _old, FaceIdx _new) {
+    for (auto &adj : m_faces[_f].m_adj) {
+      if (adj == _old)
+        adj = _new;
+    }
+  };
+  replace_adj(f_bc, _face, g);
+  replace_adj(g_ad, g, _face);
+  auto &face = m_faces[_face];
+  face.m_vert = {c, a, d};
+  face.m_adj = {f_ca, g_ad, g};
+  set_plane(face);
+  auto &oth = m_faces[g];
+  oth.m_vert = {d, b, c};
+  oth.m_adj = {g_db, f_bc, _face};
+  set_plane(oth);
+  return true;
+}
+
+bool QuickHull::remove_vertex(FaceIdx _face, VertIdx _v) {
+  if (star(_face, _v, m_star) != 3 ||
+      m_faces.size() - m_free_faces.size() <= 4)
+    return false;
+  // The star turns clockwise around _v: the new face has the edges opposite
+  // to _v, x[0], x[1], x[2] counterclockwise.
+  std::array<VertIdx, 3> x;
+  std::array<FaceIdx, 3> out;
+  for (size_t k = 0; k < 3; ++k) {
+    const auto &face = m_faces[m_star[k]];
+    size_t i = 0;
+    while (face.m_vert[i] != _v)
+      ++i;
+    x[(3 - k) % 3] = face.m_vert[(i + 1) % 3];
+    out[(3 - k) % 3] = face.m_adj[(i + 1) % 3];
+  }
+  if (Geo::orient3d(m_verts[x[0]], m_verts[x[1]], m_verts[x[2]],
+                    m_verts[_v]) > 0)
+    return false;
+  auto nf = m_star[0];
+  for (size_t k = 1; k < 3; ++k) {
+    m_faces[m_star[k]].m_alive = false;
+    m_free_faces.push_back(m_star[k]);
+    for (auto &adj : m_faces[out[(3 - k) % 3]].m_adj) {
+      if (adj == m_star[k])
+        adj = nf;
+    }
+  }
+  auto &face = m_faces[nf];
+  face.m_vert = x;
+  face.m_adj = out;
+  set_plane(face);
+  return true;
+}
+
+bool QuickHull::make_convex() {
+  if (m_faces.empty())
+    return false;
+  std::vector<FaceIdx> stack;
+  for (FaceIdx f = 0; f < m_faces.size(); ++f) {
+    if (m_faces[f].m_alive)
+      stack.push_back(f);
+  }
+  // Every flip or removal makes the surface more convex locally, but not
+  // always globally: the steps are bounded.
+  auto max_steps = 4 * m_faces.size() + 64;
+  size_t steps = 0;
+  while (!stack.empty()) {
+    auto f = stack.back();
+    stack.pop_back();
+    for (size_t i = 0; i < 3 && m_faces[f].m_alive; ++i) {
+      const auto &face = m_faces[f];
+      auto g = face.m_adj[i];
+      auto j = twin_edge(f, i);
+      if (!outside(face, m_verts[m_faces[g].m_vert[(j + 2) % 3]]))
+        continue;
+      if (++steps > max_steps)
+        return false;
+      auto a = face.m_vert[i], b = face.m_vert[(i + 1) % 3];
+      if (flip_edge(f, i)) {
+        stack.push_back(f);
+        stack.push_back(g);
+      } else if (remove_vertex(f, a) || remove_vertex(f, b)) {
+        stack.push_back(f);
+      } else {
+        continue;
+      }
+      for (auto h : {f, g}) {
+        if (m_faces[h].m_alive)
+          stack.insert(stack.end(), m_faces[h].m_adj.begin(),
+                       m_faces[h].m_adj.end());
+      }
+      break;
+    }
+  }
+  return convex();
+}
+
+bool QuickHull::convex() const {
+  for (FaceIdx f = 0; f < m_faces.size(); ++f) {
+    const auto &face = m_faces[f];
+    if (!face.m_alive)
+      continue;
+    if (face.distance(m_center) >= 0)
+      return false;
+    for (size_t i = 0; i < 3; ++i) {
+      const auto &adj = m_faces[face.m_adj[i]];
+      if (outside(face, m_verts[adj.m_vert[(twin_edge(f, i) + 2) % 3]]))
+        return false;
+    }
+  }
+  return true;
+}
+
+void QuickHull::to_mesh(Mesh &_mesh, std::vector<uint32_t> *_input) const {
+  if (_input != nullptr)
+    _input->clear();
+  if (m_faces.empty()) {
+    std::vector<size_t> index;
+    make_flat_hull(m_verts.data(), m_verts.size(), m_tol, _mesh, &index);
+    if (_input != nullptr) {
+      for (auto i : index)
+        _input->push_back(m_vert_input[i]);
+    }
+    return;
+  }
+  _mesh = Mesh();
+  std::vector<VertIdx> degree(m_verts.size(), 0);
+  for (const auto &face : m_faces) {
+    if (face.m_alive) {
+      for (auto v : face.m_vert)
+        ++degree[v];
+    }
+  }
+  std::vector<VertIdx> vert_map(m_verts.size(), INVALID);
+  for (size_t v = 0; v < m_verts.size(); ++v) {
+    if (degree[v] == 0)
+      continue;
+    vert_map[v] = _mesh.add_vertex(m_verts[v], degree[v]);
+    if (_input != nullptr)
+      _input->push_back(m_vert_input[v]);
+    _mesh.m_box += m_verts[v];
+    _mesh.m_mid_pt += m_verts[v];
+  }
+  if (_mesh.size() > 0)
+    _mesh.m_mid_pt /= static_cast<double>(_mesh.size());
+  for (const auto &face : m_faces) {
+    if (!face.m_alive)
+      continue;
+    auto &mesh_face = _mesh.m_faces.emplace_back();
+    for (size_t i = 0; i < 3; ++i) {
+      _mesh.add_adjacent(vert_map[face.m_vert[i]],
+                         vert_map[face.m_vert[(i + 1) % 3]]);
+      mesh_face.m_vert[i] = vert_map[face.m_vert[i]];
+    }
+    mesh_face.m_normal = face.m_normal;
+    mesh_face.m_dist = face.m_dist;
+  }
+}
+
+void make_flat_hull(PointView _pts, size_t _size, double _tol, Mesh &_mesh,
+                    std::vector<size_t> *_index) {
+  _mesh = Mesh();
+  if (_index != nullptr)
+    _index->clear();
+  std::array<size_t, 4> simplex;
+  auto dim = initial_simplex(_pts, _size, _tol, simplex);
+  std::vector<VertIdx> loop;
+  auto add = [&_pts, &_mesh, &loop, _index](size_t _i, VertIdx _adj_cap) {
+    loop.push_back(_mesh.add_vertex(_pts[_i], _adj_cap));
+    if (_index != nullptr)
+      _index->push_back(_i);
+  };
+  if (dim == 1)
+    add(simplex[0], 0);
+  else if (dim == 2) {
+    for (size_t i = 0; i < 2; ++i)
+      add(simplex[i], 1);
+  } else if (dim >= 3) {
+    // Andrew's monotone chain in a frame of the plane of the points.
+    auto orig = _pts[simplex[0]];
+    auto u = _pts[simplex[1]] - orig;
+    u /= Geo::length(u);
+    auto norm = u % (_pts[simplex[2]] - orig);
+    auto v = norm % u;
+    v /= Geo::length(v);
+    std::vector<std::pair<Geo::VectorD2, size_t>> pts2d(_size);
+    for (size_t i = 0; i < _size; ++i) {
+      auto d = _pts[i] - orig;
+      pts2d[i] = {{d * u, d * v}, i};
+    }
+    std::sort(pts2d.begin(), pts2d.end());
+    std::vector<size_t> chain;
+    auto turns_left = [&pts2d, &chain](size_t _i) {
+      const auto &a = pts2d[chain[chain.size() - 2]].first;
+      const auto &b = pts2d[chain.back()].first;
+      return (b - a) % (pts2d[_i].first - a) > 0;
+    };
+    for (int pass = 0; pass < 2; ++pass) {
+      auto min_size = chain.size() + 1;
+      for (size_t k = 0; k < _size; ++k) {
+        auto i = pass == 0 ? k : _size - 1 - k;
+        while (chain.size() > min_size && !turns_left(i))
+          chain.pop_back();
+        chain.push_back(i);
+      }
+      chain.pop_back();
+    }
+    for (auto i : chain)
+      add(pts2d[i].second, 2);
+  }
+  for (auto v : loop) {
+    _mesh.m_box += _mesh.point(v);
+    _mesh.m_mid_pt += _mesh.point(v);
+  }
+  if (!loop.empty())
+    _mesh.m_mid_pt /= static_cast<double>(loop.size());
+  if (loop.size() == 2) {
+    _mesh.add_adjacent(loop[0], loop[1]);
+    _mesh.add_adjacent(loop[1], loop[0]);
+  } else if (loop.size() > 2) {
+    for (size_t i = 0; i < loop.size(); ++i) {
+      _mesh.add_adjacent(loop[i], loop[(i + 1) % loop.size()]);
+      _mesh.add_adjacent(loop[(i + 1) % loop.size()], loop[i]);
+    }
+  }
+}
+
+std::vector<VertIdx> find_corners(const Mesh &_mesh) {
+  const size_t NONE = std::numeric_limits<size_t>::max();
+  std::vector<std::array<size_t, 2>> planes(_mesh.size(), {NONE, NONE});
+  std::vector<uint8_t> corner(_mesh.size(), 0);
+  const auto &faces = _mesh.m_faces;
+  // True if the face _f is on the plane of the face _g.
+  auto coplanar = [&_mesh, &faces](size_t _f, size_t _g) {
+    const auto &g = faces[_g].m_vert;
+    for (auto v : faces[_f].m_vert) {
+      if (Geo::orient3d(_mesh.point(g[0]), _mesh.point(g[1]),
+                        _mesh.point(g[2]), _mesh.point(v)) != 0)
+        return false;
+    }
+    return true;
+  };
+  auto collinear = [&_mesh, &faces](size_t _f) {
+    const auto &a = _mesh.point(faces[_f].m_vert[0]);
+    const auto &b = _mesh.point(faces[_f].m_vert[1]);
+    const auto &c = _mesh.point(faces[_f].m_vert[2]);
+    for (size_t i = 0; i < 3; ++i) {
+      auto j = (i + 1) % 3;
+      if (Geo::orient2d({a[i], a[j]}, {b[i], b[j]}, {c[i], c[j]}) != 0)
+        return false;
+    }
+    return true;
+  };
+  for (size_t f = 0; f < faces.size(); ++f) {
+    if (collinear(f))
+      continue;
+    for (auto v : faces[f].m_vert) {
+      auto &pl = planes[v];
+      if (corner[v])
+        continue;
+      if (pl[0] == NONE)
+        pl[0] = f;
+      else if (coplanar(f, pl[0]))
+        continue;
+      else if (pl[1] == NONE)
+        pl[1] = f;
+      else if (!coplanar(f, pl[1]))
+        corner[v] = 1;
+    }
+  }
+  std::vector<VertIdx> res;
+  for (VertIdx v = 0; v < _mesh.size(); ++v) {
+    if (corner[v])
+      res.push_back(v);
+  }
+  return res;
+}
+
+void keep_corners(Mesh &_mesh, HullStats *_stats) {
+  auto corners = find_corners(_mesh);
+  if (corners.empty() || corners.size() == _mesh.size())
+    return;
+  Points pts(corners.size());
+  for (size_t i = 0; i < corners.size(); ++i)
+    pts[i] = _mesh.point(corners[i]);
+  QuickHull hull;
+  if (hull.build(pts.data(), pts.size()))
+    hull.to_mesh(_mesh);
+  if (_stats)
+    _stats->m_quickhull_dropped += hull.dropped();
+}
+
+void make_quick_hull(PointView _pts, size_t _size, IHullTrace *_trace,
+                     Mesh &_mesh, HullStats *_stats) {
+  QuickHull hull;
+  if (hull.build(_pts, _size, _trace)) {
+    hull.to_mesh(_mesh);
+    keep_corners(_mesh, _stats);
+  } else
+    make_flat_hull(_pts, _size, hull.tolerance(), _mesh);
+  if (_stats)
+    _stats->m_quickhull_dropped += hull.dropped();
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "point_hull.hh"
+
+#include <array>
+#include <limits>
+#include <vector>
+
+// Input points of the quickhull in double or single precision. The single
+// precision ones are widened when read, which is exact, so the predicates
+// stay robust and the input needs no widened copy. The loops over many
+// points take the raw array of its precision.
+class PointView {
+public:
+  PointView() = default;
+  PointView(const Geo::VectorD3 *_pts) : m_pts64(_pts) {}
+  PointView(const Geo::VectorF3 *_pts) : m_pts32(_pts) {}
+
+  Geo::VectorD3 operator[](size_t _i) const {
+    if (m_pts64 != nullptr)
+      return m_pts64[_i];
+    return widen(m_pts32[_i]);
+  }
+  const Geo::VectorD3 *data64() const { return m_pts64; }
+  const Geo::VectorF3 *data32() const { return m_pts32; }
+
+  static const Geo::VectorD3 &widen(const Geo::VectorD3 &_pt) { return _pt; }
+  static Geo::VectorD3 widen(const Geo::VectorF3 &_pt) {
+    return {_pt[0], _pt[1], _pt[2]};
+  }
+
+private:
+  const Geo::VectorD3 *m_pts64 = nullptr;
+  const Geo::VectorF3 *m_pts32 = nullptr;
+};
+
+// Quickhull in 3D. The hull is a closed triangulated surface with the faces
+// oriented outwards. The input points still outside of it are kept in
+// conflict lists: every face owns a slot of the single array m_conflicts.
+// A built hull can grow with insert(): only the faces seen from the new
+// points change. The decisions use exact orientation predicates near the
+// faces, so coplanar and grid aligned inputs keep a valid surface.
+class QuickHull {
+public:
+  using FaceIdx = uint32_t;
+  static constexpr FaceIdx INVALID = std::numeric_limits<FaceIdx>::max();
+  // The input points are indexed with 32 bits: build() and insert() throw
+  // with more points than this. The conflict array, that holds up to as much
+  // garbage as points between two compactions, has 64-bit offsets.
+  static constexpr size_t MAX_POINTS = std::numeric_limits<uint32_t>::max();
+
+  struct Face {
+    // Counterclockwise seen from outside.
+    std::array<VertIdx, 3> m_vert;
+    // m_adj[i] is the face across the edge m_vert[i], m_vert[i + 1].
+    std::array<FaceIdx, 3> m_adj;
+    // The plane is m_normal * x == m_dist, m_normal has unit length.
+    Geo::VectorD3 m_normal;
+    double m_dist;
+    // Bound of the rounding error of distance() in units of the tolerance:
+    // the normal of a thin face is inaccurate.
+    double m_dist_err = 1;
+    size_t m_confl_off = 0;
+    uint32_t m_confl_nmbr = 0;
+    uint32_t m_far_pt = 0;
+    double m_far_dist = 0;
+    uint32_t m_mark = 0;
+    bool m_alive = false;
+
+    double distance(const Geo::VectorD3 &_pt) const {
+      return m_normal * _pt - m_dist;
+    }
+  };
+
+  // Builds the hull of _pts. Returns false if the points do not span 3
+  // dimensions.
+  bool build(PointView _pts, size_t _size, IHullTrace *_trace = nullptr);
+  // Takes the faces of a hull mesh, made from its adjacency if it has none.
+  // Returns false if the mesh is flat: its vertices wait for insert().
+  // _input, if given, has the input index of every vertex of the mesh.
+  bool build(const Mesh &_mesh, const uint32_t *_input = nullptr);
+  // Adds the points of _pts outside the hull. The points in the ball around
+  // the inner point that touches the nearest face are skipped; the others
+  // are located walking along the ray from the inner point, starting from
+  // the face of the previous point. _input, if given, has the input index of
+  // every point, else it is its position in _pts.
+  void insert(PointView _pts, size_t _size, IHullTrace *_trace = nullptr,
+              const uint32_t *_input = nullptr);
+  // True if no face has a neighbour beyond it and the inner point is below
+  // every face: the surface bounds a convex polytope. A hull taken by
+  // build(const Mesh &) with moved vertices can fail it.
+  bool convex() const;
+  // Repairs a hull taken by build(const Mesh &) with moved vertices: flips
+  // the edges where the surface folds inwards and removes the vertices of
+  // degree 3 that sank below their neighbours. Only the faces around the
+  // folds change. Returns convex(): false if the folds are not local.
+  bool make_convex();
+  // _input, if given, gets the input index of every vertex of _mesh: its
+  // position in the points of the build() or of the insert() that added it.
+  // The mesh can have vertices on the faces and edges of the hull, see
+  // keep_corners().
+  void to_mesh(Mesh &_mesh, std::vector<uint32_t> *_input = nullptr) const;
+
+  double tolerance() const { return m_tol; }
+  // Points of the last build() or insert() left outside the hull: the
+  // region of the faces they see was never a disk, even after the other
+  // points changed it.
+  size_t dropped() const { return m_deferred.size(); }
+  const std::vector<Face> &faces() const { return m_faces; }
+  const std::vector<Geo::VectorD3> &vertices() const { return m_verts; }
+
+private:
+  // Empties the hull. The arrays keep their memory for the next build.
+  void clear();
+  FaceIdx new_face(VertIdx _v0, VertIdx _v1, VertIdx _v2);
+  void set_plane(Face &_face) const;
+  // True if _pt is strictly outside the face. The plane distance decides
+  // beyond the tolerance, an exact orientation test within it.
+  bool outside(const Face &_face, const Geo::VectorD3 &_pt) const;
+  // Distributes the points of _pts among the faces of _faces.
+  void assign_conflicts(const std::vector<uint32_t> &_pts,
+                        const std::vector<FaceIdx> &_faces);
+  template <class PointT>
+  void assign_conflicts(const PointT *_input, const std::vector<uint32_t> &_pts,
+                        const std::vector<FaceIdx> &_faces);
+  // Adds input point _pt, visible from _face, as a new hull vertex. Returns
+  // false and leaves the hull as it was if the visible region has not a
+  // simple boundary.
+  bool add_point(uint32_t _pt, FaceIdx _face);
+  // Tries again the points that add_point() refused, if they are still
+  // outside. Returns true if it added any.
+  bool add_deferred(const uint32_t *_input, IHullTrace *_trace);
+  void compact_conflicts();
+  // Squeezes out the vertices on no face and the dead faces once the dead
+  // vertices outnumber the live ones, so that a hull grown by many insert()
+  // keeps a size in proportion to its vertices.
+  void compact();
+  // Face crossed by the ray from m_center to _pt or INVALID.
+  FaceIdx locate(const Geo::VectorD3 &_pt) const;
+  // Index in the face across edge _edge of _face of the same edge.
+  size_t twin_edge(FaceIdx _face, size_t _edge) const;
+  // Faces around vertex _v of _face, in order. Returns their number.
+  size_t star(FaceIdx _face, VertIdx _v, std::vector<FaceIdx> &_faces) const;
+  // Replaces edge _edge of _face with the other diagonal of its two faces.
+  // Returns false if that diagonal is already an edge or the new faces
+  // would not face away from the inner point.
+  bool flip_edge(FaceIdx _face, size_t _edge);
+  // Replaces the 3 faces around _v, a vertex of _face, with one if _v is not
+  // above it.
+  bool remove_vertex(FaceIdx _face, VertIdx _v);
+
+  PointView m_input;
+  double m_tol = 0;
+  // A point strictly inside the hull.
+  Geo::VectorD3 m_center{};
+  FaceIdx m_last_face = 0;
+  std::vector<Geo::VectorD3> m_verts;
+  // Input index of every vertex.
+  std::vector<uint32_t> m_vert_input;
+  std::vector<Face> m_faces;
+  std::vector<FaceIdx> m_free_faces;
+  std::vector<uint32_t> m_conflicts;
+  size_t m_conflict_garbage = 0;
+  std::vector<FaceIdx> m_pending;
+  // Input points that add_point() refused.
+  std::vector<uint32_t> m_deferred;
+  uint32_t m_mark = 0;
+  // Per vertex: the mark of the last horizon it is on and the new faces that
+  // start and end there.
+  std::vector<uint32_t> m_vert_mark;
+  std::vector<std::array<FaceIdx, 2>> m_vert_faces;
+  // Scratch buffers of add_point().
+  std::vector<FaceIdx> m_visible;
+  std::vector<std::array<FaceIdx, 2>> m_horizon;
+  std::vector<FaceIdx> m_new_faces;
+  std::vector<uint32_t> m_orphans;
+  // Scratch buffer of make_convex().
+  std::vector<FaceIdx> m_star;
+};
+
+// Hull of points that do not span 3 dimensions: a polygon, a segment or a
+// single point. Only the adjacency of the boundary is set. _index, if given,
+// gets the position in _pts of every vertex.
+void make_flat_hull(PointView _pts, size_t _size, double _tol, Mesh &_mesh,
+                    std::vector<size_t> *_index = nullptr);
+
+// Vertices of _mesh whose faces are in 3 planes or more, which are the
+// vertices of the hull without the perturbation. The faces of 3 points on
+// a line are skipped.
+std::vector<VertIdx> find_corners(const Mesh &_mesh);
+
+// Rebuilds the hull _mesh from its corners if it has other vertices: the
+// points that a quickhull added outside a face and that the hull grown
+// afterwards left on one of its faces or edges. _stats, if given, gets the
+// dropped points.
+void keep_corners(Mesh &_mesh, HullStats *_stats = nullptr);
+
+// Quickhull of _pts, falling back to make_flat_hull(). Its vertices are the
+// corners, as the ones of the divide and conquer hull. _stats, if given,
+// gets the dropped points.
+void make_quick_hull(PointView _pts, size_t _size, IHullTrace *_trace,
+                     Mesh &_mesh, HullStats *_stats = nullptr);
@@ -0,0 +1,145 @@
+#include "support_hierarchy.hh"
+#include "quick_hull.hh"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+// A level keeps one vertex out of LEVEL_RATIO of the previous one.
+const size_t LEVEL_RATIO = 16;
+// The last level is scanned.
+const size_t TOP_SIZE = 16;
+// Bits per axis of the codes that sort the vertices of a level.
+const size_t MORTON_BITS = 10;
+
+uint32_t morton_code(const Geo::VectorD3 &_pt, const Geo::Range<3> &_box) {
+  uint32_t code = 0;
+  for (size_t c = 0; c < 3; ++c) {
+    auto len = _box[1][c] - _box[0][c];
+    auto cell = len > 0 ? uint32_t((_pt[c] - _box[0][c]) / len *
+                                   ((1 << MORTON_BITS) - 1))
+                        : 0;
+    for (size_t b = 0; b < MORTON_BITS; ++b)
+      code |= ((cell >> b) & 1) << (3 * b + c);
+  }
+  return code;
+}
+
+} // namespace
+
+SupportHierarchy::Level
+SupportHierarchy::make_level(const Mesh &_mesh,
+                             const std::vector<VertIdx> &_down) {
+  // The vertices in the order of a Morton curve: the ones a climb visits
+  // are close in memory too.
+  Geo::Range<3> box;
+  for (const auto &pt : _mesh.m_pts)
+    box += pt;
+  std::vector<std::pair<uint32_t, VertIdx>> keys(_mesh.size());
+  for (VertIdx v = 0; v < _mesh.size(); ++v)
+    keys[v] = {morton_code(_mesh.point(v), box), v};
+  std::sort(keys.begin(), keys.end());
+  std::vector<VertIdx> new_idx(_mesh.size());
+  for (VertIdx v = 0; v < _mesh.size(); ++v)
+    new_idx[keys[v].second] = v;
+
+  Level level;
+  level.m_pts.resize(_mesh.size());
+  level.m_down.resize(_mesh.size());
+  level.m_adj_off.resize(_mesh.size() + 1);
+  level.m_adj_off[0] = 0;
+  for (VertIdx v = 0; v < _mesh.size(); ++v) {
+    auto old = keys[v].second;
+    level.m_pts[v] = _mesh.point(old);
+    level.m_down[v] = _down[old];
+    for (auto w : _mesh.adjacent(old))
+      level.m_adj.push_back(new_idx[w]);
+    level.m_adj_off[v + 1] = VertIdx(level.m_adj.size());
+  }
+  return level;
+}
+
+SupportHierarchy::SupportHierarchy(const Mesh &_mesh) {
+  std::vector<VertIdx> down(_mesh.size());
+  std::iota(down.begin(), down.end(), 0);
+  m_levels.push_back(make_level(_mesh, down));
+
+  std::vector<VertIdx> kept, order;
+  std::vector<Geo::VectorD3> kept_pts;
+  Mesh hull;
+  while (m_levels.back().m_pts.size() > TOP_SIZE) {
+    const auto &prev = m_levels.back();
+    // The vertices are in Morton order: the sample covers the surface
+    // evenly.
+    kept.clear();
+    kept_pts.clear();
+    for (VertIdx v = 0; v < prev.m_pts.size(); v += LEVEL_RATIO) {
+      kept.push_back(v);
+      kept_pts.push_back(prev.m_pts[v]);
+    }
+    if (kept.size() < 4)
+      break;
+    make_quick_hull(kept_pts.data(), kept_pts.size(), nullptr, hull);
+
+    // The hull copies its vertices from the input: find them by value.
+    order.resize(kept.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&kept_pts](VertIdx _a, VertIdx _b) {
+      return kept_pts[_a] < kept_pts[_b];
+    });
+    down.resize(hull.size());
+    for (VertIdx v = 0; v < hull.size(); ++v) {
+      auto pos = *std::lower_bound(
+          order.begin(), order.end(), hull.point(v),
+          [&kept_pts](VertIdx _a, const Geo::VectorD3 &_pt) {
+            return kept_pts[_a] < _pt;
+          });
+      down[v] = kept[pos];
+    }
+    m_levels.push_back(make_level(hull, down));
+  }
+}
+
+VertIdx SupportHierarchy::climb(const Level &_level, const Geo::VectorD3 &_dir,
+                                VertIdx _v) {
+  auto val = _dir * _level.m_pts[_v];
+  for (;;) {
+    auto next = _v;
+    for (auto i = _level.m_adj_off[_v]; i < _level.m_adj_off[_v + 1]; ++i) {
+      auto w = _level.m_adj[i];
+      auto w_val = _dir * _level.m_pts[w];
+      if (w_val > val) {
+        val = w_val;
+        next = w;
+      }
+    }
+    if (next == _v)
+      return _v;
+    _v = next;
+  }
+}
+
+VertIdx SupportHierarchy::support(const Geo::VectorD3 &_dir) const {
+  const auto &top = m_levels.back();
+  VertIdx v = 0;
+  if (top.m_pts.size() <= TOP_SIZE) {
+    for (VertIdx w = 1; w < top.m_pts.size(); ++w) {
+      if (_dir * top.m_pts[w] > _dir * top.m_pts[v])
+        v = w;
+    }
+  } else {
+    v = climb(top, _dir, v);
+  }
+  for (auto level = m_levels.size() - 1; level > 0; --level)
+    v = climb(m_levels[level - 1], _dir, m_levels[level].m_down[v]);
+  return m_levels[0].m_down[v];
+}
+
+void SupportHierarchy::support(const Geo::VectorD3 *_dirs, size_t _size,
+                               VertIdx *_result, IExecutor *_exec) const {
+  parallel_for(_exec, _size, 1 << 12, [&](size_t _b, size_t _e) {
+    for (auto i = _b; i < _e; ++i)
+      _result[i] = support(_dirs[i]);
+  });
+}
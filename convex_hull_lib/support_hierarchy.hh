@@ -0,0 +1,52 @@
+#pragma once
+
+#include "point_hull.hh"
+
+#include <vector>
+
+// Extreme vertex queries on a compacted hull, in the way of the
+// Dobkin-Kirkpatrick hierarchy. Every level is the hull of an even sample of
+// the vertices of the previous one, down to a few vertices. A query scans
+// the last level and descends: the extreme vertex of a level starts a climb
+// along the edges of the previous one, that takes a few steps because the
+// sample is dense around it. A convex surface has no local maximum that is
+// not global, so the answer is exact whatever the shape of the levels.
+// The queries do not change the object and can run from many threads.
+class SupportHierarchy {
+public:
+  explicit SupportHierarchy(const Mesh &_mesh);
+
+  // Vertex of the mesh with the largest _dir * x. The mesh must have a
+  // vertex.
+  VertIdx support(const Geo::VectorD3 &_dir) const;
+  // Answers the queries _dirs[i] in _result[i], split among the tasks of
+  // _exec when given.
+  void support(const Geo::VectorD3 *_dirs, size_t _size, VertIdx *_result,
+               IExecutor *_exec = nullptr) const;
+
+  size_t levels() const { return m_levels.size(); }
+  size_t level_size(size_t _level) const {
+    return m_levels[_level].m_pts.size();
+  }
+
+private:
+  // Vertices and adjacency in contiguous arrays: the neighbours of vertex v
+  // are [m_adj_off[v], m_adj_off[v + 1]) of m_adj.
+  struct Level {
+    std::vector<Geo::VectorD3> m_pts;
+    std::vector<VertIdx> m_adj_off;
+    std::vector<VertIdx> m_adj;
+    // Index of every vertex in the previous level, or in the mesh for the
+    // first level.
+    std::vector<VertIdx> m_down;
+  };
+
+  // Level of the vertices of _mesh, _down[v] is the index of vertex v below.
+  static Level make_level(const Mesh &_mesh,
+                          const std::vector<VertIdx> &_down);
+  // Climbs from _v along the edges of _level while _dir * x grows.
+  static VertIdx climb(const Level &_level, const Geo::VectorD3 &_dir,
+                       VertIdx _v);
+
+  std::vector<Level> m_levels;
+};
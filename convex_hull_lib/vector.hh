@@ -157,6 +157,7 @@ template <typename ValT, size_t dimT> using Vector = std::array<ValT, dimT>;
 template <size_t dimT> using VectorD = Vector<double, dimT>;
 typedef VectorD<3> VectorD3;
 typedef VectorD<2> VectorD2;
+typedef Vector<float, 3> VectorF3;
 
 // [a, b, c] is perpendicular to
 // [b-c, c-a, a-b]
@@ -1,10 +1,24 @@
 
+#include "../convex_hull_lib/approx_hull.hh"
+#include "../convex_hull_lib/hull_batch.hh"
+#include "../convex_hull_lib/hull_classifier.hh"
+#include "../convex_hull_lib/interior_cull.hh"
+#include "../convex_hull_lib/mesh_writer.hh"
+#include "../convex_hull_lib/point_file.hh"
 #include "../convex_hull_lib/point_hull.hh"
+#include "../convex_hull_lib/point_loader.hh"
+#include "../convex_hull_lib/point_morton.hh"
+#include "../convex_hull_lib/point_soa.hh"
+#include "../convex_hull_lib/predicates.hh"
+#include "../convex_hull_lib/quick_hull.hh"
+#include "../convex_hull_lib/support_hierarchy.hh"
 
 #include "gtest_wrapper.hpp"
 
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <random>
 #include <string>
 
 namespace fs = std::filesystem;
@@ -46,33 +60,9 @@ std::string get_test_output_directory() {
   return path.generic_string();
 }
 
-static void load_mesh(Points& _pts) {
-  auto flnm = get_test_input_directory();
-  flnm += "/mesh.obj";
-  std::ifstream f(flnm);
-  std::string line;
-  auto skip_non_blank = [](std::istream &_in) {
-    char c;
-    while (_in.good()) {
-      _in >> c;
-      if (c == ' ')
-        break;
-    }
-  };
-
-  while (std::getline(f, line)) {
-    if (line.size() < 3 || line[1] != ' ')
-      continue;
-    std::istringstream buf(line.c_str() + 2);
-    buf >> std::noskipws;
-    if (line[0] == 'v') {
-      _pts.emplace_back();
-      for (auto &coord : _pts.back()) {
-        buf >> coord;
-        skip_non_blank(buf);
-      }
-    }
-  }
+static void load_mesh(Points &_pts,
+                      std::string _dir = get_test_input_directory()) {
+  load_obj_points(_dir + "/mesh.obj", _pts);
 }
 
 std::string set_test_output_directory_as_current() {
@@ -82,28 +72,1026 @@ std::string set_test_output_directory_as_current() {
 }
 
 TEST(CvxHull, Basic00) {
-  set_test_output_directory_as_current();
+  HullOptions opts;
+  opts.m_trace =
+      IHullTrace::make_obj_dump(set_test_output_directory_as_current());
   Points pts{{0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 1, 1},
              {1, 0, 0}, {1, 0, 1}, {1, 1, 0}, {1, 1, 1}};
-  auto mesh = make_convex_hull(pts);
+  auto mesh = make_convex_hull(pts, opts);
   mesh->compact();
-  save_mesh(mesh);
+  mesh->save("mesh.obj");
 }
 
 TEST(CvxHull, Basic01) {
-  set_test_output_directory_as_current();
+  HullOptions opts;
+  opts.m_trace =
+      IHullTrace::make_obj_dump(set_test_output_directory_as_current());
   Points pts{{0, 0, 0}, {2, 0, 0}, {2, 1, 0}, {1, 1, 0}, {1, 2, 0}, {0, 2, 0},
              {0, 0, 1}, {2, 0, 1}, {2, 1, 1}, {1, 1, 1}, {1, 2, 1}, {0, 2, 1}};
-  auto mesh = make_convex_hull(pts);
+  auto mesh = make_convex_hull(pts, opts);
   mesh->compact();
-  save_mesh(mesh);
+  mesh->save("mesh.obj");
 }
 
 TEST(CvxHull, Basic02) {
-  set_test_output_directory_as_current();
+  HullOptions opts;
+  opts.m_trace =
+      IHullTrace::make_obj_dump(set_test_output_directory_as_current());
   Points pts;
   load_mesh(pts);
+  auto mesh = make_convex_hull(pts, opts);
+  mesh->compact();
+  mesh->save("mesh.obj");
+}
+
+TEST(CvxHull, Parallel00) {
+  set_test_output_directory_as_current();
+  Points pts{{0, 0, 0}, {2, 0, 0}, {2, 1, 0}, {1, 1, 0}, {1, 2, 0}, {0, 2, 0},
+             {0, 0, 1}, {2, 0, 1}, {2, 1, 1}, {1, 1, 1}, {1, 2, 1}, {0, 2, 1}};
+  auto pts_par = pts;
   auto mesh = make_convex_hull(pts);
   mesh->compact();
-  save_mesh(mesh);
+  HullOptions opts;
+  opts.m_executor = IExecutor::make_thread_pool(4);
+  opts.m_parallel_cutoff = 4;
+  auto mesh_par = make_convex_hull(pts_par, opts);
+  mesh_par->compact();
+  EXPECT_EQ(mesh->size(), mesh_par->size());
+  mesh_par->save("mesh.obj");
+}
+
+TEST(CvxHull, Trace00) {
+  Points pts{{0, 0, 0}, {2, 0, 0}, {2, 1, 0}, {1, 1, 0}, {1, 2, 0}, {0, 2, 0},
+             {0, 0, 1}, {2, 0, 1}, {2, 1, 1}, {1, 1, 1}, {1, 2, 1}, {0, 2, 1}};
+  auto trace = std::make_shared<HullTraceCapture>();
+  HullOptions opts;
+  opts.m_trace = trace;
+  auto mesh = make_convex_hull(pts, opts);
+  // 4 leaves and 3 merges. (1, 1, 0) and (1, 1, 1) are on the bottom and top
+  // faces, so the hull of the 10 corners is made again.
+  ASSERT_EQ(trace->m_meshes.size(), 14u);
+  EXPECT_EQ(trace->m_meshes.back().size(),
+            mesh->size());
+}
+
+TEST(CvxHull, Stats00) {
+  Points pts{{0, 0, 0}, {2, 0, 0}, {2, 1, 0}, {1, 1, 0}, {1, 2, 0}, {0, 2, 0},
+             {0, 0, 1}, {2, 0, 1}, {2, 1, 1}, {1, 1, 1}, {1, 2, 1}, {0, 2, 1}};
+  HullOptions opts;
+  opts.m_stats = std::make_shared<HullStats>();
+  auto mesh = make_convex_hull(pts, opts);
+  const auto &stats = *opts.m_stats;
+  // 4 leaves and 3 merges, twice: the second time for the 10 corners.
+  EXPECT_EQ(stats.m_max_depth, 2u);
+  EXPECT_EQ(stats.m_merges, 6u);
+  EXPECT_GE(stats.m_wrap_steps, stats.m_merges);
+  EXPECT_GT(stats.m_allocated_bytes, 0u);
+  EXPECT_GT(stats.m_merge_ns, 0u);
+}
+
+TEST(CvxHull, Presort00) {
+  Points pts{{0, 0, 0}, {2, 0, 0}, {2, 1, 0}, {1, 1, 0}, {1, 2, 0}, {0, 2, 0},
+             {0, 0, 1}, {2, 0, 1}, {2, 1, 1}, {1, 1, 1}, {1, 2, 1}, {0, 2, 1}};
+  auto pts_sort = pts;
+  auto mesh = make_convex_hull(pts);
+  HullOptions opts;
+  opts.m_presort = true;
+  opts.m_stats = std::make_shared<HullStats>();
+  auto mesh_sort = make_convex_hull(pts_sort, opts);
+  EXPECT_EQ(mesh->size(), mesh_sort->size());
+  // The hull of the 10 corners is made again.
+  EXPECT_EQ(opts.m_stats->m_merges, 6u);
+
+  // The splits of large ranges are octree planes.
+  std::mt19937 gen(0);
+  std::normal_distribution<double> norm;
+  Points cloud(100000);
+  for (auto &pt : cloud)
+    pt = {norm(gen), norm(gen), norm(gen)};
+  PointsMorton morton(cloud.data(), cloud.size());
+  std::vector<std::array<size_t, 2>> ranges{{0, cloud.size()}};
+  while (!ranges.empty()) {
+    auto [begin, end] = ranges.back();
+    ranges.pop_back();
+    size_t coord;
+    auto mid = morton.split(begin, end, coord);
+    ASSERT_GE(mid - begin, 2u);
+    ASSERT_GE(end - mid, 2u);
+    auto left_max = morton.point(begin), right_min = morton.point(mid);
+    for (auto i = begin; i < end; ++i) {
+      const auto &pt = morton.point(i);
+      if (i < mid && Geo::perturbed_less(left_max, pt, coord))
+        left_max = pt;
+      else if (i >= mid && Geo::perturbed_less(pt, right_min, coord))
+        right_min = pt;
+    }
+    EXPECT_TRUE(Geo::perturbed_less(left_max, right_min, coord));
+    if (end - begin > 1000) {
+      ranges.push_back({begin, mid});
+      ranges.push_back({mid, end});
+    }
+  }
+}
+
+TEST(CvxHull, Append00) {
+  // Triangle with a deleted vertex in the middle of it.
+  Mesh mesh, oth;
+  for (auto &pt : Points{{0, 0, 0}, {1, 0, 0}, {0.2, 0.2, 0}, {0, 1, 0}})
+    oth.add_vertex(pt);
+  for (VertIdx v : {0, 1, 3}) {
+    for (VertIdx w : {0, 1, 3}) {
+      if (v != w)
+        oth.add_adjacent(v, w);
+    }
+  }
+  oth.set_flag(2, MeshVertex::TO_DEL, true);
+  oth.m_dead_nmbr = 1;
+  mesh.add_vertex({5, 5, 5});
+  std::pmr::vector<VertIdx> ind_map;
+  mesh.append(oth, ind_map);
+  ASSERT_EQ(mesh.size(), 4u);
+  EXPECT_EQ(mesh.m_dead_nmbr, 0u);
+  EXPECT_EQ(ind_map[2], std::numeric_limits<VertIdx>::max());
+  EXPECT_EQ(mesh.point(ind_map[3]), oth.point(3));
+  auto adj = mesh.adjacent(ind_map[3]);
+  ASSERT_EQ(adj.size(), 2u);
+  EXPECT_EQ(adj.begin()[0], ind_map[0]);
+  EXPECT_EQ(adj.begin()[1], ind_map[1]);
+}
+
+TEST(CvxHull, Cull00) {
+  Points corners{{0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 1, 1},
+                 {1, 0, 0}, {1, 0, 1}, {1, 1, 0}, {1, 1, 1}};
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> unif(0.01, 0.99);
+  Points pts(10000);
+  for (auto &pt : pts)
+    pt = {unif(gen), unif(gen), unif(gen)};
+  pts.insert(pts.begin() + 5000, corners.begin(), corners.end());
+  size_t prev_culled = 0;
+  for (size_t dir_nmbr : {6, 14, 26}) {
+    auto pts_dir = pts;
+    auto culled = cull_interior_points(pts_dir.begin(), pts_dir.end(),
+                                       dir_nmbr,
+                                       IExecutor::make_thread_pool(4).get());
+    // More directions give a bigger polytope.
+    EXPECT_GE(culled, prev_culled);
+    prev_culled = culled;
+    auto kept_end = pts_dir.end() - culled;
+    for (const auto &corner : corners)
+      EXPECT_NE(std::find(pts_dir.begin(), kept_end, corner), kept_end);
+  }
+  // The 26 directions find all the corners of the cube.
+  EXPECT_EQ(prev_culled, pts.size() - corners.size());
+
+  HullOptions opts;
+  opts.m_cull_directions = 26;
+  opts.m_stats = std::make_shared<HullStats>();
+  auto mesh = make_convex_hull(pts, opts);
+  EXPECT_EQ(mesh->size(), corners.size());
+  EXPECT_EQ(opts.m_stats->m_culled_points, prev_culled);
+}
+
+TEST(CvxHull, Cull01) {
+  // Several chunks of the parallel pass, split among the tasks.
+  std::mt19937 gen(0);
+  std::normal_distribution<double> norm;
+  Points pts(5 << 16);
+  for (auto &pt : pts)
+    pt = {norm(gen), norm(gen), norm(gen)};
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  const auto pts_all_input = pts;
+  auto pts_all = pts;
+  auto hull = make_convex_hull(pts_all, opts);
+  auto exec = IExecutor::make_thread_pool(4);
+  auto pts_serial = pts;
+  auto culled_serial =
+      cull_interior_points(pts_serial.begin(), pts_serial.end(), 26);
+  auto culled = cull_interior_points(pts.begin(), pts.end(), 26, exec.get());
+  EXPECT_GT(culled, pts.size() / 2);
+  EXPECT_EQ(culled, culled_serial);
+  // The parallel pass moves the points as the serial one, and the kept and
+  // the culled points are both in the input order.
+  EXPECT_EQ(pts, pts_serial);
+  size_t kept_pos = 0, culled_pos = pts.size() - culled;
+  for (const auto &pt : pts_all_input) {
+    if (kept_pos < pts.size() - culled && pts[kept_pos] == pt)
+      ++kept_pos;
+    else if (culled_pos < pts.size() && pts[culled_pos] == pt)
+      ++culled_pos;
+  }
+  EXPECT_EQ(kept_pos, pts.size() - culled);
+  EXPECT_EQ(culled_pos, pts.size());
+  // No hull vertex is culled.
+  std::sort(pts.begin(), pts.end() - culled);
+  for (VertIdx v = 0; v < hull->size(); ++v) {
+    EXPECT_TRUE(
+        std::binary_search(pts.begin(), pts.end() - culled, hull->point(v)));
+  }
+
+  // The hull with the parallel pass counts the same points.
+  pts_all = pts;
+  opts.m_cull_directions = 26;
+  opts.m_executor = exec;
+  opts.m_stats = std::make_shared<HullStats>();
+  EXPECT_EQ(make_convex_hull(pts_all, opts)->size(), hull->size());
+  EXPECT_EQ(opts.m_stats->m_culled_points, culled);
+}
+
+// Every input point is inside or on all the faces, by the exact predicate,
+// none was dropped and the surface is closed.
+static void check_quick_hull(const Points &_pts, const QuickHull &_hull) {
+  EXPECT_EQ(_hull.dropped(), 0u);
+  const auto &verts = _hull.vertices();
+  size_t face_nmbr = 0;
+  for (const auto &face : _hull.faces()) {
+    if (!face.m_alive)
+      continue;
+    ++face_nmbr;
+    for (auto adj : face.m_adj)
+      EXPECT_TRUE(_hull.faces()[adj].m_alive);
+    for (const auto &pt : _pts) {
+      EXPECT_LE(Geo::orient3d(verts[face.m_vert[0]], verts[face.m_vert[1]],
+                              verts[face.m_vert[2]], pt),
+                0);
+    }
+  }
+  Mesh mesh;
+  _hull.to_mesh(mesh);
+  EXPECT_EQ(face_nmbr, 2 * mesh.size() - 4);
+}
+
+// Grid of _size^3 points rotated around z and flattened: the points of
+// every layer are coplanar only up to rounding, so the faces are thin.
+static Points make_rotated_grid(int _size) {
+  Points grid;
+  auto c = std::cos(0.3), s = std::sin(0.3);
+  for (int i = 0; i < _size; ++i)
+    for (int j = 0; j < _size; ++j)
+      for (int k = 0; k < _size; ++k)
+        grid.push_back({c * i - s * j, s * i + c * j, 0.1 * k});
+  std::shuffle(grid.begin(), grid.end(), std::mt19937(0));
+  return grid;
+}
+
+// The divide and conquer hull of _pts has every point inside or on all its
+// faces, by the exact predicate. Its vertices are the corners of the hull,
+// the same as the ones of the quickhull.
+static void check_divide_and_conquer(const Points &_pts,
+                                     const HullOptions &_opts) {
+  auto pts = _pts;
+  auto mesh = make_convex_hull(pts, _opts);
+  ASSERT_FALSE(mesh->m_faces.empty());
+  size_t outside = 0;
+  for (const auto &face : mesh->m_faces) {
+    for (const auto &pt : _pts) {
+      outside += Geo::orient3d(mesh->point(face.m_vert[0]),
+                               mesh->point(face.m_vert[1]),
+                               mesh->point(face.m_vert[2]), pt) > 0;
+    }
+  }
+  EXPECT_EQ(outside, 0u);
+
+  HullOptions quick_opts;
+  quick_opts.m_engine = HullEngine::QuickHull;
+  pts = _pts;
+  auto quick = make_convex_hull(pts, quick_opts);
+  Points verts(mesh->m_pts.begin(), mesh->m_pts.end());
+  Points quick_verts(quick->m_pts.begin(), quick->m_pts.end());
+  std::sort(verts.begin(), verts.end());
+  std::sort(quick_verts.begin(), quick_verts.end());
+  EXPECT_EQ(verts, quick_verts);
+}
+
+TEST(CvxHull, QuickHull00) {
+  Points cube{{0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 1, 1},
+              {1, 0, 0}, {1, 0, 1}, {1, 1, 0}, {1, 1, 1}};
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> unif(0, 1);
+  auto pts = cube;
+  for (size_t i = 0; i < 1000; ++i)
+    pts.push_back({unif(gen), unif(gen), unif(gen)});
+  QuickHull hull;
+  ASSERT_TRUE(hull.build(pts.data(), pts.size()));
+  check_quick_hull(pts, hull);
+
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  EXPECT_EQ(make_convex_hull(pts, opts)->size(), cube.size());
+
+  // Points on a sphere are all hull vertices.
+  std::normal_distribution<double> norm;
+  Points sphere(1000);
+  for (auto &pt : sphere) {
+    pt = {norm(gen), norm(gen), norm(gen)};
+    pt /= Geo::length(pt);
+  }
+  ASSERT_TRUE(hull.build(sphere.data(), sphere.size()));
+  check_quick_hull(sphere, hull);
+  EXPECT_EQ(make_convex_hull(sphere, opts)->size(), sphere.size());
+
+  // Thin faces, whose plane distances are inaccurate, keep every point
+  // inside.
+  auto grid = make_rotated_grid(16);
+  ASSERT_TRUE(hull.build(grid.data(), grid.size()));
+  check_quick_hull(grid, hull);
+  opts.m_stats = std::make_shared<HullStats>();
+  make_convex_hull(grid, opts);
+  EXPECT_EQ(opts.m_stats->m_quickhull_dropped, 0u);
+  opts.m_stats.reset();
+
+  // The square of a planar input.
+  Points flat{{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0.5, 0.5, 0}};
+  EXPECT_FALSE(hull.build(flat.data(), flat.size()));
+  EXPECT_EQ(make_convex_hull(flat, opts)->size(), 4u);
+}
+
+TEST(CvxHull, QuickHull01) {
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  set_test_output_directory_as_current();
+  Points pts;
+  load_mesh(pts, std::string(INPUT_DATA_DIR) + "CvxHull/Basic02");
+  ASSERT_FALSE(pts.empty());
+  QuickHull hull;
+  ASSERT_TRUE(hull.build(pts.data(), pts.size()));
+  check_quick_hull(pts, hull);
+  auto mesh = make_convex_hull(pts, opts);
+  mesh->save("mesh.obj");
+}
+
+TEST(CvxHull, DivideAndConquer00) {
+  HullOptions opts;
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> unif(0, 1);
+  Points random(2000);
+  for (auto &pt : random)
+    pt = {unif(gen), unif(gen), unif(gen)};
+  check_divide_and_conquer(random, opts);
+
+  // Corners, points on the faces and inside of a cube.
+  Points cube;
+  for (int i = 0; i < 8; ++i)
+    cube.push_back({double(i & 1), double((i >> 1) & 1), double(i >> 2)});
+  for (size_t i = 0; i < 1000; ++i) {
+    Geo::VectorD3 pt{unif(gen), unif(gen), unif(gen)};
+    if (i % 2 == 0)
+      pt[i % 3] = double(i % 4 == 0);
+    cube.push_back(pt);
+  }
+  std::shuffle(cube.begin(), cube.end(), gen);
+  check_divide_and_conquer(cube, opts);
+
+  Points grid;
+  for (int i = 0; i < 8; ++i)
+    for (int j = 0; j < 8; ++j)
+      for (int k = 0; k < 8; ++k)
+        grid.push_back({double(i), double(j), double(k)});
+  std::shuffle(grid.begin(), grid.end(), gen);
+  check_divide_and_conquer(grid, opts);
+  check_divide_and_conquer(make_rotated_grid(8), opts);
+
+  // Two coplanar layers, with repeated points.
+  Points slab;
+  for (size_t i = 0; i < 1000; ++i)
+    slab.push_back({unif(gen), unif(gen), double(i % 2)});
+  slab.insert(slab.end(), slab.begin(), slab.begin() + 100);
+  check_divide_and_conquer(slab, opts);
+}
+
+TEST(CvxHull, DivideAndConquer01) {
+  // The SoA splits, the parallel recursion, the presort and the lazy
+  // compaction on clouds of a few thousand points.
+  std::mt19937 gen(1);
+  std::normal_distribution<double> norm;
+  std::uniform_real_distribution<double> unif(-1, 1);
+  std::vector<Points> clouds(3);
+  for (size_t i = 0; i < 3000; ++i)
+    clouds[0].push_back({norm(gen), norm(gen), norm(gen)});
+  for (size_t i = 0; i < 4000; ++i)
+    clouds[1].push_back({unif(gen), unif(gen), unif(gen)});
+  for (size_t i = 0; i < 2000; ++i) {
+    Geo::VectorD3 pt{norm(gen), norm(gen), norm(gen)};
+    clouds[2].push_back(pt / Geo::length(pt));
+  }
+  HullOptions serial, parallel, presort;
+  parallel.m_executor = IExecutor::make_thread_pool(4);
+  parallel.m_parallel_cutoff = 256;
+  presort.m_presort = true;
+  for (const auto &cloud : clouds) {
+    for (const auto *opts : {&serial, &parallel, &presort})
+      check_divide_and_conquer(cloud, *opts);
+  }
+}
+
+// A cube with square faces: every vertex is adjacent to 3 others.
+static Mesh make_cube_mesh() {
+  Mesh cube;
+  for (int i = 0; i < 8; ++i) {
+    cube.add_vertex({double(i & 1), double((i >> 1) & 1), double(i >> 2)}, 3);
+    cube.m_box += cube.m_pts.back();
+  }
+  for (VertIdx v = 0; v < 8; ++v) {
+    for (VertIdx bit = 1; bit < 8; bit <<= 1)
+      cube.add_adjacent(v, v ^ bit);
+  }
+  return cube;
+}
+
+TEST(CvxHull, Incremental00) {
+  auto cube = make_cube_mesh();
+  QuickHull hull;
+  ASSERT_TRUE(hull.build(cube));
+  Points all(cube.m_pts.begin(), cube.m_pts.end());
+  check_quick_hull(all, hull);
+
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> unif(-0.5, 1.5);
+  for (size_t batch = 0; batch < 10; ++batch) {
+    Points pts(100);
+    for (auto &pt : pts)
+      pt = {unif(gen), unif(gen), unif(gen)};
+    hull.insert(pts.data(), pts.size());
+    all.insert(all.end(), pts.begin(), pts.end());
+    check_quick_hull(all, hull);
+  }
+  Mesh mesh;
+  hull.to_mesh(mesh);
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  EXPECT_EQ(mesh.size(), make_convex_hull(all, opts)->size());
+
+  // Every inserted point of a grid with thin faces is inside.
+  auto grid = make_rotated_grid(12);
+  ASSERT_TRUE(hull.build(grid.data(), 100));
+  for (size_t b = 100; b < grid.size(); b += 400) {
+    auto e = std::min<size_t>(b + 400, grid.size());
+    hull.insert(grid.data() + b, e - b);
+    check_quick_hull(Points(grid.begin(), grid.begin() + e), hull);
+  }
+
+  // A flat start becomes solid with the first point off its plane.
+  Points square{{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}};
+  ASSERT_FALSE(hull.build(*make_convex_hull(square, opts)));
+  Geo::VectorD3 apex{0.5, 0.5, 1};
+  hull.insert(&apex, 1);
+  hull.to_mesh(mesh);
+  EXPECT_EQ(mesh.size(), 5u);
+
+  // The input indices survive a flat insert and the one that makes the
+  // hull solid: the square has 10 to 13, the points on its plane 20 and 21
+  // and the apex 30.
+  auto square_mesh = make_convex_hull(square, opts);
+  std::vector<uint32_t> square_input{10, 11, 12, 13};
+  ASSERT_FALSE(hull.build(*square_mesh, square_input.data()));
+  Points flat{{0.5, 0.5, 0}, {2, 0.5, 0}};
+  std::vector<uint32_t> flat_input{20, 21};
+  hull.insert(flat.data(), flat.size(), nullptr, flat_input.data());
+  auto expected_input = [&](const Geo::VectorD3 &_pt) {
+    for (VertIdx v = 0; v < square_mesh->size(); ++v) {
+      if (square_mesh->point(v) == _pt)
+        return square_input[v];
+    }
+    return _pt == flat[1] ? 21u : _pt == apex ? 30u : 0u;
+  };
+  std::vector<uint32_t> input;
+  hull.to_mesh(mesh, &input);
+  ASSERT_EQ(input.size(), 5u);
+  for (VertIdx v = 0; v < mesh.size(); ++v)
+    EXPECT_EQ(input[v], expected_input(mesh.point(v)));
+  uint32_t apex_input = 30;
+  hull.insert(&apex, 1, nullptr, &apex_input);
+  hull.to_mesh(mesh, &input);
+  ASSERT_EQ(input.size(), 6u);
+  for (VertIdx v = 0; v < mesh.size(); ++v)
+    EXPECT_EQ(input[v], expected_input(mesh.point(v)));
+}
+
+TEST(CvxHull, Stream00) {
+  auto out_dir = set_test_output_directory_as_current();
+  std::mt19937 gen(0);
+  std::normal_distribution<double> norm;
+  Points pts(20000);
+  for (auto &pt : pts)
+    pt = {norm(gen), norm(gen), norm(gen)};
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  auto pts_mem = pts;
+  auto size = make_convex_hull(pts_mem, opts)->size();
+
+  opts.m_chunk_size = 3000;
+  size_t pos = 0;
+  auto source = IPointSource::make_callback(
+      [&pts, &pos](Geo::VectorD3 *_buf, size_t _max) {
+        auto nmbr = std::min(_max, pts.size() - pos);
+        std::copy_n(pts.begin() + pos, nmbr, _buf);
+        pos += nmbr;
+        return nmbr;
+      });
+  EXPECT_EQ(make_convex_hull(*source, opts)->size(), size);
+
+  {
+    std::ofstream f("points.raw", std::ios::binary);
+    f.write(reinterpret_cast<const char *>(pts.data()),
+            pts.size() * sizeof(Geo::VectorD3));
+  }
+  auto file = IPointSource::make_raw_file(out_dir + "/points.raw");
+  EXPECT_EQ(make_convex_hull(*file, opts)->size(), size);
+}
+
+TEST(CvxHull, Stream01) {
+  // Points sorted along x: every chunk buries most of the hull so far.
+  std::mt19937 gen(0);
+  std::normal_distribution<double> norm;
+  Points pts(200000);
+  for (auto &pt : pts)
+    pt = {norm(gen), norm(gen), norm(gen)};
+  std::sort(pts.begin(), pts.end());
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  QuickHull hull;
+  Mesh mesh;
+  for (size_t pos = 0; pos < pts.size(); pos += 2000) {
+    Points chunk(pts.begin() + pos, pts.begin() + pos + 2000);
+    auto chunk_hull = make_convex_hull(chunk, opts);
+    hull.insert(chunk_hull->m_pts.data(), chunk_hull->size());
+    hull.to_mesh(mesh);
+    EXPECT_LE(hull.vertices().size(), 2 * mesh.size());
+    EXPECT_LE(hull.faces().size(), 2 * (2 * mesh.size() - 4));
+  }
+  check_quick_hull(pts, hull);
+  EXPECT_EQ(mesh.size(), make_convex_hull(pts, opts)->size());
+}
+
+TEST(CvxHull, Batch00) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> unif(-1, 1);
+  std::uniform_int_distribution<size_t> set_size(1, 300);
+  Points pts;
+  std::vector<size_t> offsets{0};
+  for (size_t i = 0; i < 500; ++i) {
+    auto size = set_size(gen);
+    // Every 10th set is flat.
+    auto z_scale = i % 10 == 0 ? 0. : 1.;
+    for (size_t j = 0; j < size; ++j)
+      pts.push_back({unif(gen), unif(gen), z_scale * unif(gen)});
+    offsets.push_back(pts.size());
+  }
+  HullOptions opts;
+  opts.m_executor = IExecutor::make_thread_pool(4);
+  auto batch =
+      make_convex_hulls(pts.data(), offsets.data(), offsets.size() - 1, opts);
+  ASSERT_EQ(batch.size(), offsets.size() - 1);
+  HullOptions quick_opts;
+  quick_opts.m_engine = HullEngine::QuickHull;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    Points set(pts.begin() + offsets[i], pts.begin() + offsets[i + 1]);
+    auto mesh = make_convex_hull(set, quick_opts);
+    ASSERT_EQ(batch.m_vert_offsets[i + 1] - batch.m_vert_offsets[i],
+              mesh->size());
+    ASSERT_EQ(batch.m_face_offsets[i + 1] - batch.m_face_offsets[i],
+              mesh->m_faces.size());
+    auto first = batch.m_verts.begin() + batch.m_vert_offsets[i];
+    for (auto f = batch.m_face_offsets[i]; f < batch.m_face_offsets[i + 1];
+         ++f) {
+      const auto &tri = batch.m_faces[f];
+      auto normal = (first[tri[1]] - first[tri[0]]) %
+                    (first[tri[2]] - first[tri[0]]);
+      for (auto j = offsets[i]; j < offsets[i + 1]; ++j)
+        ASSERT_LE(normal * (pts[j] - first[tri[0]]), 1e-12);
+    }
+  }
+}
+
+TEST(CvxHull, Float00) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> unif(-1, 1);
+  PointsF pts_f(5000);
+  for (auto &pt : pts_f)
+    pt = {unif(gen), unif(gen), unif(gen)};
+  // Coplanar points on the faces of the cube [-1, 1]^3.
+  for (size_t i = 0; i < 1000; ++i)
+    pts_f.push_back({unif(gen), unif(gen), i % 2 == 0 ? -1.f : 1.f});
+  Points pts;
+  for (const auto &pt : pts_f)
+    pts.push_back({pt[0], pt[1], pt[2]});
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  auto mesh_f = make_convex_hull(pts_f, opts);
+  auto mesh = make_convex_hull(pts, opts);
+  ASSERT_EQ(mesh_f->size(), mesh->size());
+  ASSERT_EQ(mesh_f->m_faces.size(), mesh->m_faces.size());
+  for (size_t i = 0; i < mesh->size(); ++i)
+    EXPECT_EQ(mesh_f->point(VertIdx(i)), mesh->point(VertIdx(i)));
+}
+
+TEST(CvxHull, PointFile00) {
+  auto out_dir = set_test_output_directory_as_current();
+  std::mt19937 gen(0);
+  std::normal_distribution<double> norm;
+  Points pts(10000);
+  for (auto &pt : pts)
+    pt = {norm(gen), norm(gen), norm(gen)};
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  auto pts_mem = pts;
+  auto size = make_convex_hull(pts_mem, opts)->size();
+
+  save_point_file(out_dir + "/points64.bin", pts.data(), pts.size());
+  MappedPointFile file64(out_dir + "/points64.bin");
+  ASSERT_EQ(file64.size(), pts.size());
+  // Little endian on any host: the scalar size is in the first byte.
+  {
+    std::ifstream f(out_dir + "/points64.bin", std::ios::binary);
+    char header[12];
+    f.read(header, sizeof(header));
+    EXPECT_EQ(header[8], char(sizeof(double)));
+    EXPECT_EQ(header[11], 0);
+  }
+  // Mapped in place only by a little endian host.
+  EXPECT_EQ(file64.data() != nullptr, little_endian_host());
+  Points loaded;
+  file64.load(loaded);
+  EXPECT_EQ(loaded, pts);
+  EXPECT_EQ(make_convex_hull(file64, opts)->size(), size);
+
+  save_point_file(out_dir + "/points32.bin", pts.data(), pts.size(), true);
+  MappedPointFile file32(out_dir + "/points32.bin");
+  EXPECT_TRUE(file32.is_float32());
+  EXPECT_EQ(file32.data(), nullptr);
+  file32.load(loaded, IExecutor::make_thread_pool(4).get());
+  ASSERT_EQ(loaded.size(), pts.size());
+  EXPECT_EQ(loaded[17][2], double(float(pts[17][2])));
+  EXPECT_EQ(make_convex_hull(file32, opts)->size(),
+            make_convex_hull(loaded, opts)->size());
+
+  EXPECT_ANY_THROW(MappedPointFile(out_dir + "/missing.bin"));
+}
+
+TEST(CvxHull, PointLoader00) {
+  set_test_output_directory_as_current();
+  Points pts{{0, 0, 0}, {1.5, -2, 3e-3}, {-1e10, 4, 0.25}};
+  {
+    std::ofstream f("points.obj");
+    f << "# comment\nvn 0 0 1\n";
+    for (const auto &pt : pts)
+      f << "v " << pt[0] << "\t" << pt[1] << " " << pt[2] << " 1\r\n";
+    f << "f 1 2 3\n";
+  }
+  Points loaded;
+  load_points("points.obj", loaded, IExecutor::make_thread_pool(4).get());
+  EXPECT_EQ(loaded, pts);
+
+  auto ply_header = [&pts](std::ostream &_f, const char *_format) {
+    _f << "ply\nformat " << _format << " 1.0\n"
+       << "element vertex " << pts.size() << "\n"
+       << "property uchar red\nproperty double z\n"
+       << "property float y\nproperty double x\n"
+       << "element face 1\nproperty list uchar int vertex_indices\n"
+       << "end_header\n";
+  };
+  {
+    std::ofstream f("points_ascii.ply");
+    ply_header(f, "ascii");
+    for (const auto &pt : pts)
+      f << "7 " << pt[2] << " " << pt[1] << " " << pt[0] << "\n";
+    f << "3 0 1 2\n";
+  }
+  load_points("points_ascii.ply", loaded);
+  EXPECT_EQ(loaded, pts);
+
+  for (const char *format : {"binary_little_endian", "binary_big_endian"}) {
+    {
+      std::ofstream f("points.ply", std::ios::binary);
+      ply_header(f, format);
+      const uint16_t one = 1;
+      bool swap = (*reinterpret_cast<const char *>(&one) == 1) !=
+                  (std::string(format) == "binary_little_endian");
+      auto put = [&f, swap](auto _val) {
+        char bytes[sizeof(_val)];
+        std::memcpy(bytes, &_val, sizeof(_val));
+        if (swap)
+          std::reverse(bytes, bytes + sizeof(_val));
+        f.write(bytes, sizeof(_val));
+      };
+      for (const auto &pt : pts) {
+        put(uint8_t(7));
+        put(pt[2]);
+        put(float(pt[1]));
+        put(pt[0]);
+      }
+    }
+    load_points("points.ply", loaded);
+    EXPECT_EQ(loaded, pts);
+  }
+
+  // An element before the vertices larger than the file, whose size in
+  // bytes wraps around to 0.
+  {
+    std::ofstream f("points_bad.ply", std::ios::binary);
+    f << "ply\nformat binary_little_endian 1.0\n"
+      << "element junk " << (uint64_t(1) << 62) << "\nproperty int a\n"
+      << "element vertex 1\nproperty double x\nproperty double y\n"
+      << "property double z\nend_header\n";
+    double xyz[3]{1, 2, 3};
+    f.write(reinterpret_cast<const char *>(xyz), sizeof(xyz));
+  }
+  EXPECT_ANY_THROW(load_points("points_bad.ply", loaded));
+}
+
+// Closed surface with every vertex inside or on every face.
+static void check_faces(const Mesh &_mesh) {
+  EXPECT_EQ(_mesh.m_faces.size(), 2 * _mesh.size() - 4);
+  auto tol = 1e-12 * Geo::length(_mesh.m_box[1] - _mesh.m_box[0]);
+  for (const auto &face : _mesh.m_faces) {
+    EXPECT_NEAR(Geo::length(face.m_normal), 1, 1e-12);
+    for (const auto &pt : _mesh.m_pts)
+      EXPECT_LE(face.m_normal * pt - face.m_dist, tol);
+  }
+}
+
+TEST(CvxHull, Faces00) {
+  set_test_output_directory_as_current();
+  // Faces made from the adjacency, the squares split in 2 triangles.
+  auto cube = make_cube_mesh();
+  cube.make_faces();
+  check_faces(cube);
+
+  std::mt19937 gen(0);
+  std::normal_distribution<double> norm;
+  Points pts(5000);
+  for (auto &pt : pts)
+    pt = {norm(gen), norm(gen), norm(gen)};
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  auto mesh = make_convex_hull(pts, opts);
+  check_faces(*mesh);
+  auto remade = *mesh;
+  remade.make_faces();
+  check_faces(remade);
+
+  Points loaded;
+  for (const char *flnm : {"mesh.obj", "mesh.ply"}) {
+    mesh->save(flnm);
+    load_points(flnm, loaded);
+    EXPECT_EQ(loaded.size(), mesh->size());
+  }
+  mesh->save("mesh.stl");
+  EXPECT_EQ(fs::file_size("mesh.stl"), 84 + 50 * mesh->m_faces.size());
+}
+
+TEST(CvxHull, Predicates00) {
+  Geo::VectorD3 a{0, 0, 0}, b{1, 0, 0}, c{0, 1, 0};
+  EXPECT_GT(Geo::orient3d(a, b, c, {0.3, 0.3, 1e-300}), 0);
+  EXPECT_LT(Geo::orient3d(a, b, c, {0.3, 0.3, -1e-300}), 0);
+  EXPECT_EQ(Geo::orient3d(a, b, c, {1e10, -3e10, 0}), 0);
+  EXPECT_GT(Geo::orient2d({0, 0}, {1, 0}, {0.5, 1e-300}), 0);
+  EXPECT_EQ(Geo::orient2d({0, 0}, {1, 1}, {3e15, 3e15}), 0);
+
+  // Points rounded near a plane: the exact sign does not depend on the
+  // order of the vertices, the one of the plain formula does.
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> unif(-1, 1);
+  auto sign = [](double _val) { return (_val > 0) - (_val < 0); };
+  size_t zeros = 0;
+  for (size_t i = 0; i < 1000; ++i) {
+    Geo::VectorD3 p[3];
+    for (auto &pt : p)
+      pt = {unif(gen), unif(gen), unif(gen)};
+    auto s = unif(gen), t = unif(gen);
+    auto d = p[0] + s * (p[1] - p[0]) + t * (p[2] - p[0]);
+    auto ref = sign(Geo::orient3d(p[0], p[1], p[2], d));
+    zeros += ref == 0;
+    EXPECT_EQ(sign(Geo::orient3d(p[1], p[2], p[0], d)), ref);
+    EXPECT_EQ(sign(Geo::orient3d(p[2], p[0], p[1], d)), ref);
+    EXPECT_EQ(sign(Geo::orient3d(p[1], p[0], p[2], d)), -ref);
+  }
+  EXPECT_LT(zeros, 1000u);
+
+  // Grid aligned input: many coplanar points on every face.
+  Points grid;
+  for (int i = 0; i < 5; ++i)
+    for (int j = 0; j < 5; ++j)
+      for (int k = 0; k < 5; ++k)
+        grid.push_back({i * 0.1, j * 0.1, k * 0.1});
+  QuickHull hull;
+  ASSERT_TRUE(hull.build(grid.data(), grid.size()));
+  check_quick_hull(grid, hull);
+}
+
+TEST(CvxHull, SoA00) {
+  // Large enough for the sampled median, with many repeated values.
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> unif(0, 99);
+  Points pts(100001);
+  for (auto &pt : pts)
+    pt = {double(unif(gen)), double(unif(gen)), double(unif(gen))};
+  PointsSoA soa(pts.data(), pts.size());
+  auto box = soa.box(0, 0, pts.size());
+  EXPECT_EQ(box[0], Geo::VectorD3({0, 0, 0}));
+  EXPECT_EQ(box[1], Geo::VectorD3({99, 99, 99}));
+  for (size_t c = 0; c < 3; ++c) {
+    // Splits the last level again, on the next coordinate.
+    size_t buf = c % 2;
+    auto mid = soa.split(buf, 0, pts.size(), c);
+    EXPECT_NEAR(double(mid), pts.size() / 2., 2000.);
+    auto sum = Geo::VectorD3({0, 0, 0});
+    // The ties are split as the perturbed points.
+    auto left_max = soa.point(1 - buf, 0), right_min = soa.point(1 - buf, mid);
+    for (size_t i = 0; i < pts.size(); ++i) {
+      auto pt = soa.point(1 - buf, i);
+      sum += pt;
+      if (i < mid && Geo::perturbed_less(left_max, pt, c))
+        left_max = pt;
+      else if (i >= mid && Geo::perturbed_less(pt, right_min, c))
+        right_min = pt;
+    }
+    EXPECT_TRUE(Geo::perturbed_less(left_max, right_min, c));
+    auto ref = Geo::VectorD3({0, 0, 0});
+    for (auto &pt : pts)
+      ref += pt;
+    EXPECT_EQ(sum, ref);
+  }
+}
+
+TEST(CvxHull, Approx00) {
+  std::mt19937 gen(0);
+  std::normal_distribution<double> norm;
+  Points pts(20000);
+  for (auto &pt : pts)
+    pt = {10 * norm(gen), norm(gen), 0.1 * norm(gen)};
+  for (size_t max_vert : {4, 8, 32, 128}) {
+    for (double max_err : {0., 0.5}) {
+      auto mesh = make_approx_hull(pts, max_vert, max_err);
+      EXPECT_LE(mesh->size(), max_vert);
+      EXPECT_EQ(mesh->m_faces.size(), 2 * mesh->size() - 4);
+      for (const auto &face : mesh->m_faces) {
+        for (const auto &pt : pts)
+          EXPECT_LE(face.m_normal * pt, face.m_dist);
+      }
+    }
+  }
+  EXPECT_THROW(make_approx_hull(pts, 3), const char *);
+}
+
+TEST(CvxHull, Support00) {
+  std::mt19937 gen(0);
+  std::normal_distribution<double> norm;
+  Points pts(5000);
+  for (auto &pt : pts) {
+    pt = {norm(gen), norm(gen), norm(gen)};
+    pt /= Geo::length(pt);
+  }
+  // A cube has ties in the directions of its faces.
+  Points cube{{0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 1, 1},
+              {1, 0, 0}, {1, 0, 1}, {1, 1, 0}, {1, 1, 1}};
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  for (auto *input : {&pts, &cube}) {
+    auto mesh = make_convex_hull(*input, opts);
+    SupportHierarchy hier(*mesh);
+    EXPECT_EQ(hier.level_size(0), mesh->size());
+    std::vector<Geo::VectorD3> dirs(1000);
+    for (auto &dir : dirs)
+      dir = {norm(gen), norm(gen), norm(gen)};
+    dirs.push_back({0, 0, 1});
+    dirs.push_back({1, 1, 0});
+    std::vector<VertIdx> res(dirs.size());
+    auto exec = IExecutor::make_thread_pool(2);
+    hier.support(dirs.data(), dirs.size(), res.data(), exec.get());
+    for (size_t i = 0; i < dirs.size(); ++i) {
+      EXPECT_EQ(res[i], hier.support(dirs[i]));
+      auto best = std::numeric_limits<double>::lowest();
+      for (const auto &pt : mesh->m_pts)
+        best = std::max(best, dirs[i] * pt);
+      EXPECT_EQ(dirs[i] * mesh->point(res[i]), best);
+    }
+  }
+}
+
+TEST(CvxHull, Classifier00) {
+  Points cube{{0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 1, 1},
+              {1, 0, 0}, {1, 0, 1}, {1, 1, 0}, {1, 1, 1}};
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  HullClassifier cube_test(*make_convex_hull(cube, opts));
+  EXPECT_EQ(cube_test.planes(), 6u);
+  EXPECT_TRUE(cube_test.inside({0.5, 0.5, 0.5}));
+  EXPECT_TRUE(cube_test.inside({1, 1, 1}));
+  EXPECT_FALSE(cube_test.inside({0.5, 0.5, 1.5}));
+
+  // A flat hull, large enough for the cells.
+  std::mt19937 gen(0);
+  std::normal_distribution<double> norm;
+  Points pts(5000);
+  for (auto &pt : pts) {
+    pt = {norm(gen), 0.1 * norm(gen), 0.01 * norm(gen)};
+    pt /= Geo::length(pt);
+  }
+  auto mesh = make_convex_hull(pts, opts);
+  HullClassifier test(*mesh);
+  EXPECT_GT(test.cells(), 1u);
+  std::uniform_real_distribution<double> unif(-1.1, 1.1);
+  std::vector<Geo::VectorD3> queries(5000);
+  for (auto &pt : queries)
+    pt = {unif(gen), 0.5 * unif(gen), 0.05 * unif(gen)};
+  std::vector<uint8_t> inside(queries.size());
+  auto exec = IExecutor::make_thread_pool(2);
+  auto inside_nmbr =
+      test.classify(queries.data(), queries.size(), inside.data(), exec.get());
+  size_t expected_nmbr = 0;
+  for (size_t i = 0; i < queries.size(); ++i) {
+    bool expected = true;
+    for (const auto &face : mesh->m_faces)
+      expected &= face.m_normal * queries[i] <= face.m_dist;
+    EXPECT_EQ(inside[i], expected ? 1 : 0);
+    expected_nmbr += expected;
+  }
+  EXPECT_EQ(inside_nmbr, expected_nmbr);
+  EXPECT_GT(inside_nmbr, 0u);
+
+  // No faces, no volume.
+  EXPECT_FALSE(HullClassifier(Mesh()).inside({0, 0, 0}));
+}
+
+TEST(CvxHull, Warm00) {
+  std::mt19937 gen(0);
+  std::normal_distribution<double> norm;
+  Points pts(5000);
+  for (auto &pt : pts) {
+    pt = {norm(gen), norm(gen), norm(gen)};
+    pt /= Geo::length(pt);
+  }
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  opts.m_stats = std::make_shared<HullStats>();
+  std::vector<uint32_t> input_idx;
+  auto mesh = make_convex_hull(pts, Mesh(), input_idx, opts);
+  EXPECT_EQ(opts.m_stats->m_warm_rebuilt, 1u);
+
+  // A still frame, frames of a slowly deforming body and a jump.
+  for (size_t frame = 1; frame <= 10; ++frame) {
+    auto scale = frame == 1 ? 0 : frame < 10 ? 1e-4 : 0.1;
+    for (auto &pt : pts)
+      pt += scale * Geo::VectorD3{norm(gen), norm(gen), norm(gen)};
+    mesh = make_convex_hull(pts, *mesh, input_idx, opts);
+    auto pts_mem = pts;
+    auto fresh = make_convex_hull(pts_mem, opts);
+    ASSERT_EQ(mesh->size(), fresh->size());
+    ASSERT_EQ(input_idx.size(), mesh->size());
+    for (VertIdx v = 0; v < mesh->size(); ++v)
+      EXPECT_EQ(mesh->point(v), pts[input_idx[v]]);
+    std::vector<Geo::VectorD3> warm_pts(mesh->m_pts.begin(), mesh->m_pts.end());
+    std::vector<Geo::VectorD3> fresh_pts(fresh->m_pts.begin(),
+                                         fresh->m_pts.end());
+    std::sort(warm_pts.begin(), warm_pts.end());
+    std::sort(fresh_pts.begin(), fresh_pts.end());
+    EXPECT_EQ(warm_pts, fresh_pts);
+  }
+  EXPECT_EQ(opts.m_stats->m_warm_kept, 1u);
+  EXPECT_GT(opts.m_stats->m_warm_repaired, 0u);
+  EXPECT_EQ(opts.m_stats->m_warm_kept + opts.m_stats->m_warm_repaired +
+                opts.m_stats->m_warm_rebuilt,
+            11u);
+}
+
+TEST(CvxHull, MergeHulls00) {
+  std::mt19937 gen(0);
+  std::normal_distribution<double> norm;
+  HullOptions opts;
+  opts.m_engine = HullEngine::QuickHull;
+  // Two overlapping clouds, one inside the first and a flat one across them.
+  Points all;
+  std::vector<std::unique_ptr<Mesh>> hulls;
+  for (auto center : {Geo::VectorD3{0, 0, 0}, Geo::VectorD3{1, 0.5, 0},
+                      Geo::VectorD3{0.1, 0, 0}}) {
+    auto scale = hulls.size() == 2 ? 0.1 : 1.;
+    Points pts(2000);
+    for (auto &pt : pts)
+      pt = center + scale * Geo::VectorD3{norm(gen), norm(gen), norm(gen)};
+    all.insert(all.end(), pts.begin(), pts.end());
+    hulls.push_back(make_convex_hull(pts, opts));
+  }
+  Points square{{-5, -5, 0.2}, {5, -5, 0.2}, {5, 5, 0.2}, {-5, 5, 0.2}};
+  all.insert(all.end(), square.begin(), square.end());
+  hulls.push_back(make_convex_hull(square, opts));
+  EXPECT_TRUE(hulls.back()->m_faces.empty());
+
+  std::vector<const Mesh *> parts;
+  for (const auto &hull : hulls)
+    parts.push_back(hull.get());
+  auto merged = make_convex_hull(parts);
+  auto expected = make_convex_hull(all, opts);
+  ASSERT_EQ(merged->size(), expected->size());
+  std::vector<Geo::VectorD3> merged_pts(merged->m_pts.begin(),
+                                        merged->m_pts.end());
+  std::vector<Geo::VectorD3> expected_pts(expected->m_pts.begin(),
+                                          expected->m_pts.end());
+  std::sort(merged_pts.begin(), merged_pts.end());
+  std::sort(expected_pts.begin(), expected_pts.end());
+  EXPECT_EQ(merged_pts, expected_pts);
+  EXPECT_EQ(merged->m_faces.size(), 2 * merged->size() - 4);
+
+  EXPECT_EQ(make_convex_hull(std::vector<const Mesh *>())->size(), 0u);
 }